@@ -0,0 +1,87 @@
+#!/bin/sh
+# Builds the four tools, generates the benchmark inputs and times every case,
+# appending one JSON object per case to results/<label>.jsonl.
+#
+#   QUICK=1   only the smallest size of each case
+#   REPS=n    runs per case; the median wall time is kept (default 3)
+#   LABEL=s   names the results (default: the commit, with -dirty if changed)
+
+set -e
+cd "$(dirname "$0")"
+
+REPS=${REPS:-3}
+if [ -z "$LABEL" ]; then
+  LABEL=$(git rev-parse --short HEAD 2>/dev/null || echo local)
+  git diff --quiet HEAD -- .. 2>/dev/null || LABEL="$LABEL-dirty"
+fi
+
+for tool in patternmatch globalalign fmsearch centerstar; do
+  mkdir -p ../$tool/obj ../$tool/bin
+  make -s -C ../$tool
+done
+
+ZALG=../patternmatch/bin/zalg
+ALIGN=../globalalign/bin/myAlign
+FMSEARCH=../fmsearch/bin/fmsearch
+CSTAR=../centerstar/bin/center_star
+GEN=bin/gensim
+
+mkdir -p data results
+OUT=results/$LABEL.jsonl
+: > "$OUT"
+
+# sizes of each case, smallest first
+GENOMES="1000000 4000000 16000000"
+PAIRS="250 1000 4000"
+FAMILIES="20x500 40x1000 80x1000"
+READS="10000 40000"
+if [ -n "$QUICK" ]; then
+  GENOMES="1000000"
+  PAIRS="250"
+  FAMILIES="20x500"
+  READS="10000"
+fi
+
+# a failed case is recorded with its status and the rest still run
+FAILED=0
+run() {
+  bin/benchrun -L "$LABEL" -r "$REPS" -o "$OUT" "$@" || FAILED=$((FAILED + 1))
+}
+
+# the inputs are generated once and kept, since the generator is deterministic
+genome() {
+  [ -f data/genome_$1.fa ] || $GEN genome -s 11 -n 4 -l "$1" -r 0.2 -m 0.1 > data/genome_$1.fa
+}
+
+for n in $GENOMES; do
+  genome "$n"
+  # a pattern that never matches, so the whole text is scanned
+  run -t zalg -c "scan_$n" -s "$n" -i data/genome_$n.fa -- $ZALG ACGTACGTACGTACGTN data/genome_$n.fa
+  run -t fmsearch -c "index_search_$n" -s "$n" -i data/genome_$n.fa -- $FMSEARCH -l data/genome_$n.fa ACGTACGTACGT
+  run -t fmsearch -c "index_write_$n" -s "$n" -i data/genome_$n.fa -- $FMSEARCH -w data/genome_$n.fmi data/genome_$n.fa
+  run -t fmsearch -c "index_load_search_$n" -s "$n" -i data/genome_$n.fmi -- $FMSEARCH -l data/genome_$n.fmi ACGTACGTACGT
+done
+
+for n in $READS; do
+  genome 1000000
+  [ -f data/reads_$n.fq ] || $GEN reads -s 12 -g data/genome_1000000.fa -n "$n" -l 150 -m 0.02 -q > data/reads_$n.fq
+  run -t fmsearch -c "map_$n" -s "$n" -i data/reads_$n.fq -- $FMSEARCH -m data/reads_$n.fq data/genome_1000000.fa
+done
+
+for n in $PAIRS; do
+  [ -f data/pair_$n.fa ] || $GEN family -s 13 -n 2 -l "$n" -m 0.1 > data/pair_$n.fa
+  run -t myAlign -c "pair_$n" -s "$n" -i data/pair_$n.fa -- $ALIGN 0 -1 -1 data/pair_$n.fa
+done
+
+for f in $FAMILIES; do
+  n=${f%x*}
+  [ -f data/family_$f.fa ] || $GEN family -s 14 -n "$n" -l "${f#*x}" -m 0.05 > data/family_$f.fa
+  run -t center_star -c "msa_$f" -s "$n" -i data/family_$f.fa -- $CSTAR 1 1 data/family_$f.fa
+  run -t center_star -c "msa_prune_$f" -s "$n" -i data/family_$f.fa -- $CSTAR -p 1 1 data/family_$f.fa
+done
+
+echo "results in bench/$OUT"
+if [ "$FAILED" -gt 0 ]; then
+  echo "$FAILED cases failed"
+  exit 1
+fi
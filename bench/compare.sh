@@ -0,0 +1,28 @@
+#!/bin/sh
+# Compares two results files case by case: wall time and peak memory of the
+# second as a ratio of the first, so values under 1 are improvements.
+
+if [ $# -ne 2 ]; then
+  echo "usage: compare.sh before.jsonl after.jsonl"
+  exit 1
+fi
+
+# pulls tool, case, wall time and peak memory out of each line
+fields() {
+  sed -e 's/.*"tool":"\([^"]*\)".*"case":"\([^"]*\)".*"wall_s":\([0-9.]*\).*"peak_rss_kb":\([0-9]*\).*/\1 \2 \3 \4/' "$1"
+}
+
+fields "$1" > /tmp/bench_a.$$
+fields "$2" > /tmp/bench_b.$$
+awk '
+  NR == FNR { wall[$1 " " $2] = $3; rss[$1 " " $2] = $4; next }
+  {
+    key = $1 " " $2
+    if (!(key in wall)) { printf "%-12s %-24s %10s\n", $1, $2, "new"; next }
+    w = wall[key] > 0 ? $3 / wall[key] : 0
+    r = rss[key] > 0 ? $4 / rss[key] : 0
+    printf "%-12s %-24s wall %8.3f -> %8.3f s (x%.2f)  rss %8d -> %8d KiB (x%.2f)\n", \
+      $1, $2, wall[key], $3, w, rss[key], $4, r
+  }
+' /tmp/bench_a.$$ /tmp/bench_b.$$
+rm -f /tmp/bench_a.$$ /tmp/bench_b.$$
@@ -0,0 +1,143 @@
+/**********************************************************************
+ * times a command and records its peak memory as a line of JSON      *
+ * benchrun.c                                                         *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MAX_REPS 64
+
+/**
+ * Helper functions
+ */
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compareDouble(const void * a, const void * b) {
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+// runs the command once with its output thrown away. Returns its exit status,
+// and its wall time and peak resident set size in KiB. If the command could
+// not be run at all, -1 is returned and both are 0.
+static int runOnce(char ** cmd, double * pWall, long * pRss) {
+  *pWall = 0;
+  *pRss = 0;
+  double start = now();
+  pid_t pid = fork();
+  if (pid < 0) return -1;
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    execvp(cmd[0], cmd);
+    _exit(127);
+  }
+  int status;
+  struct rusage ru;
+  if (wait4(pid, &status, 0, &ru) < 0) return -1;
+  *pWall = now() - start;
+  *pRss = ru.ru_maxrss;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+// writes s as a JSON string
+static void jsonString(FILE * f, const char * s) {
+  fputc('"', f);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') fputc('\\', f);
+    if ((unsigned char) *s >= 0x20) fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  char * label = "local";
+  char * tool = "";
+  char * name = "";
+  char * input = NULL;
+  char * outPath = NULL;
+  long long size = 0;
+  int reps = 3;
+
+  int argi = 1;
+  for (; argi < argc && strcmp(argv[argi], "--") != 0; argi++) {
+    char * val = argi + 1 < argc ? argv[argi + 1] : NULL;
+    if (!val) break;
+    if (strcmp(argv[argi], "-L") == 0) label = val;
+    else if (strcmp(argv[argi], "-t") == 0) tool = val;
+    else if (strcmp(argv[argi], "-c") == 0) name = val;
+    else if (strcmp(argv[argi], "-i") == 0) input = val;
+    else if (strcmp(argv[argi], "-s") == 0) size = atoll(val);
+    else if (strcmp(argv[argi], "-r") == 0) reps = atoi(val);
+    else if (strcmp(argv[argi], "-o") == 0) outPath = val;
+    else break;
+    argi++;
+  }
+  if (argi >= argc - 1 || strcmp(argv[argi], "--") != 0) {
+    fprintf(stdout, "usage: benchrun [-L label] [-t tool] [-c case] [-i input] [-s size]\n"
+                    "         [-r reps] [-o results.jsonl] -- command [args]\n");
+    return 1;
+  }
+  char ** cmd = argv + argi + 1;
+  if (reps < 1) reps = 1;
+  if (reps > MAX_REPS) reps = MAX_REPS;
+
+  // the input's size is what throughput is measured against
+  long long bytes = 0;
+  struct stat st;
+  if (input && stat(input, &st) == 0) bytes = st.st_size;
+
+  double walls [MAX_REPS];
+  long rss = 0;
+  int status = 0;
+  for (int r = 0; r < reps && status == 0; r++) {
+    long peak = 0;
+    status = runOnce(cmd, &walls[r], &peak);
+    if (peak > rss) rss = peak;
+    if (status < 0) fprintf(stderr, "error running %s\n", cmd[0]);
+    if (status != 0) reps = r + 1;
+  }
+  qsort(walls, reps, sizeof(double), compareDouble);
+  double median = walls[reps / 2];
+
+  FILE * out = outPath ? fopen(outPath, "a") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "error writing file at %s\n", outPath);
+    return 1;
+  }
+  fprintf(out, "{\"label\":");
+  jsonString(out, label);
+  fprintf(out, ",\"tool\":");
+  jsonString(out, tool);
+  fprintf(out, ",\"case\":");
+  jsonString(out, name);
+  fprintf(out, ",\"size\":%lld,\"bytes\":%lld,\"reps\":%d,\"wall_s\":%.6f,\"wall_min_s\":%.6f,"
+               "\"mb_per_s\":%.3f,\"peak_rss_kb\":%ld,\"status\":%d}\n",
+    size, bytes, reps, median, walls[0], median > 0 ? bytes / median / 1e6 : 0.0, rss, status);
+  if (outPath) fclose(out);
+
+  fprintf(stderr, "%-12s %-24s %10.3f s %8.1f MB/s %8ld KiB%s\n", tool, name, median,
+    median > 0 ? bytes / median / 1e6 : 0.0, rss, status ? "  FAILED" : "");
+  return status ? 1 : 0;
+}
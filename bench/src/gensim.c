@@ -0,0 +1,247 @@
+/**********************************************************************
+ * deterministic synthetic sequences for benchmarking                 *
+ * gensim.c                                                           *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "seqio.h"
+#include "packdna.h"
+
+#define LINE_WIDTH   60  // characters per FASTA line
+#define REPEAT_LIB   8   // distinct repeat elements in a genome
+#define REPEAT_LEN   300 // length of a repeat element, and of a unique segment
+
+static const char DNA [] = "ACGT";
+static const char PROTEIN [] = "ACDEFGHIKLMNPQRSTVWY";
+
+typedef struct genParams_S {
+  uint64_t         seed;
+  const char *     alph;
+  size_t           nRecords;
+  size_t           length;    // of the genome, a family member or a read
+  double           repeats;   // fraction of a genome made of repeat copies
+  double           mutation;  // chance of an edit at each position
+  char *           genome;    // FASTA file reads are sampled from
+  bool             fastq;
+  bool             both;      // sample reads from both strands
+} genParams;
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same sequences
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static double uniform(void) {
+  return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+static void randomSeq(char * out, size_t n, const char * alph) {
+  size_t k = strlen(alph);
+  for (size_t i = 0; i < n; i++) {
+    out[i] = alph[below(k)];
+  }
+}
+
+// copies src to out with a substitution, insertion or deletion at each
+// position with probability rate, in the ratio 2:1:1. out must have room for
+// twice n. Returns the length written.
+static size_t mutate(char * src, size_t n, double rate, const char * alph, char * out) {
+  size_t k = strlen(alph);
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    double u = uniform();
+    if (u >= rate) {
+      out[m++] = src[i];
+    } else if (u < rate / 2) {
+      char c;
+      do c = alph[below(k)]; while (c == src[i] && k > 1);
+      out[m++] = c;
+    } else if (u < rate * 3 / 4) {
+      out[m++] = src[i];
+      out[m++] = alph[below(k)];
+    }
+  }
+  return m;
+}
+
+static void writeRecord(FILE * f, char * name, char * s, size_t n, bool fastq) {
+  if (fastq) {
+    fprintf(f, "@%s\n%.*s\n+\n", name, (int) n, s);
+    for (size_t i = 0; i < n; i++) fputc('I', f);
+    fputc('\n', f);
+    return;
+  }
+  fprintf(f, ">%s\n", name);
+  for (size_t i = 0; i < n; i += LINE_WIDTH) {
+    size_t w = n - i < LINE_WIDTH ? n - i : LINE_WIDTH;
+    fprintf(f, "%.*s\n", (int) w, s + i);
+  }
+}
+
+// records of unique sequence with a fraction of diverged copies of a small
+// library of repeat elements laid in, segment by segment
+static void genome(FILE * f, genParams * p) {
+  char * lib = malloc(REPEAT_LIB * REPEAT_LEN);
+  randomSeq(lib, REPEAT_LIB * REPEAT_LEN, p->alph);
+  size_t per = p->length / p->nRecords;
+  char * s = malloc(per + 2 * REPEAT_LEN);
+  char name [32];
+  for (size_t r = 0; r < p->nRecords; r++) {
+    size_t n = 0;
+    while (n < per) {
+      if (uniform() < p->repeats) {
+        char * e = lib + below(REPEAT_LIB) * REPEAT_LEN;
+        n += mutate(e, REPEAT_LEN, p->mutation, p->alph, s + n);
+      } else {
+        randomSeq(s + n, REPEAT_LEN, p->alph);
+        n += REPEAT_LEN;
+      }
+    }
+    snprintf(name, sizeof(name), "chr%zu", r + 1);
+    writeRecord(f, name, s, per, p->fastq);
+  }
+  free(s);
+  free(lib);
+}
+
+// mutated copies of one random sequence, as an MSA or alignment input
+static void family(FILE * f, genParams * p) {
+  char * base = malloc(p->length);
+  char * s = malloc(2 * p->length + 1);
+  randomSeq(base, p->length, p->alph);
+  char name [32];
+  for (size_t r = 0; r < p->nRecords; r++) {
+    size_t n = mutate(base, p->length, p->mutation, p->alph, s);
+    snprintf(name, sizeof(name), "s%zu", r);
+    writeRecord(f, name, s, n, p->fastq);
+  }
+  free(s);
+  free(base);
+}
+
+// reads sampled uniformly from the forward strand of a genome file, named
+// r<i>_<record>_<offset> after where they came from. With both, each read is
+// reverse complemented with chance 1/2 and the name ends in _+ or _-.
+static bool reads(FILE * f, genParams * p) {
+  seqSet * set = readSeqSet(p->genome);
+  if (!set) return false;
+  size_t total = 0;
+  for (size_t i = 0; i < set->n; i++) {
+    total += set->rec[i].len >= p->length ? set->rec[i].len - p->length + 1 : 0;
+  }
+  if (total == 0) {
+    fprintf(stdout, "no record of %s is as long as a read\n", p->genome);
+    freeSeqSet(set);
+    return false;
+  }
+  char * s = malloc(2 * p->length + 1);
+  char * rc = malloc(2 * p->length + 1);
+  char name [256];
+  for (size_t r = 0; r < p->nRecords; r++) {
+    size_t pick = nextRandom() % total;
+    size_t i = 0;
+    for (;; i++) {
+      size_t starts = set->rec[i].len >= p->length ? set->rec[i].len - p->length + 1 : 0;
+      if (pick < starts) break;
+      pick -= starts;
+    }
+    size_t n = mutate(set->rec[i].seq + pick, p->length, p->mutation, p->alph, s);
+    if (p->both && nextRandom() % 2) {
+      reverseComplement(rc, s, n);
+      snprintf(name, sizeof(name), "r%zu_%s_%zu_-", r, set->rec[i].name, pick);
+      writeRecord(f, name, rc, n, p->fastq);
+    } else {
+      snprintf(name, sizeof(name), p->both ? "r%zu_%s_%zu_+" : "r%zu_%s_%zu", r, set->rec[i].name, pick);
+      writeRecord(f, name, s, n, p->fastq);
+    }
+  }
+  free(rc);
+  free(s);
+  freeSeqSet(set);
+  return true;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  genParams p = { 1, DNA, 1, 1000, 0, 0, NULL, false, false };
+  if (argc < 2) {
+    fprintf(stdout, "usage: gensim genome|family|reads [-s seed] [-a dna|protein] [-n records]\n"
+                    "         [-l length] [-r repeats] [-m mutation] [-g genome.fa] [-q] [-b]\n");
+    return 1;
+  }
+  char * mode = argv[1];
+  for (int argi = 2; argi < argc; argi++) {
+    char * opt = argv[argi];
+    char * val = argi + 1 < argc ? argv[argi + 1] : NULL;
+    if (strcmp(opt, "-q") == 0) {
+      p.fastq = true;
+      continue;
+    }
+    if (strcmp(opt, "-b") == 0) {
+      p.both = true;
+      continue;
+    }
+    if (!val) {
+      fprintf(stdout, "missing a value for %s\n", opt);
+      return 1;
+    }
+    argi++;
+    if (strcmp(opt, "-s") == 0) {
+      p.seed = strtoull(val, NULL, 10);
+    } else if (strcmp(opt, "-a") == 0) {
+      p.alph = strcmp(val, "protein") == 0 ? PROTEIN : DNA;
+    } else if (strcmp(opt, "-n") == 0) {
+      p.nRecords = strtoull(val, NULL, 10);
+    } else if (strcmp(opt, "-l") == 0) {
+      p.length = strtoull(val, NULL, 10);
+    } else if (strcmp(opt, "-r") == 0) {
+      p.repeats = atof(val);
+    } else if (strcmp(opt, "-m") == 0) {
+      p.mutation = atof(val);
+    } else if (strcmp(opt, "-g") == 0) {
+      p.genome = val;
+    } else {
+      fprintf(stdout, "unknown option %s\n", opt);
+      return 1;
+    }
+  }
+  if (p.nRecords == 0 || p.length == 0) {
+    fprintf(stdout, "expected at least one record of at least one character\n");
+    return 1;
+  }
+  state = p.seed;
+
+  if (strcmp(mode, "genome") == 0) {
+    genome(stdout, &p);
+  } else if (strcmp(mode, "family") == 0) {
+    family(stdout, &p);
+  } else if (strcmp(mode, "reads") == 0 && p.genome) {
+    if (!reads(stdout, &p)) return 1;
+  } else {
+    fprintf(stdout, "expected genome, family, or reads with -g genome.fa\n");
+    return 1;
+  }
+  return 0;
+}
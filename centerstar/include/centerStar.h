@@ -0,0 +1,83 @@
+/**********************************************************************
+ * center star algorithm for approximate MSA                          *
+ * centerStar.h                                                       *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef CENTERSTAR_H
+#define CENTERSTAR_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "align.h"
+#include "context.h"
+#include "editdist.h"
+#include "scoreCache.h"
+#include "seqio.h"
+#include "packdna.h"
+#include "stats.h"
+
+// a batch of independent tasks handed out to a fixed set of threads. Each
+// task gets the arena of the thread running it.
+typedef void (* taskFn)(void *, uint32_t, dpArena *);
+typedef struct taskPool_S {
+  taskFn fn;
+  void * ctx;
+  uint32_t nTasks;
+  atomic_uint next;
+} taskPool;
+
+// how the center is picked and how much of the machine to use
+typedef struct starOptions_S {
+  uint32_t         nThreads;
+  bool             sketch;  // pick the center from k-mer sketches
+  bool             prune;   // find the exact center by branch and bound
+  scoreCache *     cache;   // pairwise scores saved between runs, or NULL
+} starOptions;
+
+// a run of len gaps placed after the first pos characters of the center
+typedef struct gapRun_S {
+  uint32_t pos;
+  uint32_t len;
+} gapRun;
+
+// the alignment of one string with the center, as runs of gaps relative to
+// the center: ins are characters of the string with no center character, and
+// del are center characters with no character of the string
+typedef struct starAlignment_S {
+  gapRun * ins;
+  uint32_t nIns;
+  gapRun * del;
+  uint32_t nDel;
+} starAlignment;
+
+// the center star MSA before it is written out
+typedef struct starMsa_S {
+  char **          pStrings;
+  uint32_t         nStrings;
+  uint32_t         c;         // index of the center
+  size_t           nSc;       // length of the center
+  uint32_t *       pnInserts; // widest insert before each center character
+  size_t           width;     // length of every row
+  starAlignment *  aligns;
+} starMsa;
+
+int alignmentScore(char *, size_t, char *, size_t, int, int, int, dpArena *);
+packedSeq ** packStrings(char **, uint32_t);
+void freePackedStrings(packedSeq **, uint32_t);
+void sharedEnds(packedSeq *, packedSeq *, size_t *, size_t *);
+void starParallelFor(uint32_t, uint32_t, taskFn, void *);
+uint32_t minSequenceDistance(char **, uint32_t, int, int, starOptions *);
+uint32_t sketchCenter(char **, uint32_t, int, int, uint32_t);
+int boundedDistance(char *, size_t, char *, size_t, int, int, int64_t, dpArena *, uint64_t *);
+uint32_t prunedCenter(char **, uint32_t, int, int, starOptions *);
+int centerStarCommand(int, char **, chainContext *);
+starMsa * centerStar(char **, uint32_t, int, int, starOptions *);
+void writeMsaRow(FILE *, starMsa *, uint32_t);
+void freeStarMsa(starMsa *);
+
+#endif
@@ -0,0 +1,45 @@
+/**********************************************************************
+ * on-disk cache of pairwise alignment scores                         *
+ * scoreCache.h                                                       *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef SCORECACHE_H
+#define SCORECACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CACHE_MAGIC   "CSSC"
+#define CACHE_VERSION 1
+
+// one saved score. A pair is keyed by the content hashes of its two strings,
+// smallest first, and the scores they were aligned with.
+typedef struct cacheEntry_S {
+  uint64_t ha;
+  uint64_t hb;
+  int32_t alpha;
+  int32_t beta;
+  int32_t score;
+  int32_t used;
+} cacheEntry;
+
+// the entries of a cache file for one pair of scores, in an open addressing
+// table. New entries are appended to the file as they are added.
+typedef struct scoreCache_S {
+  FILE * pFile;
+  int alpha;
+  int beta;
+  size_t size;
+  size_t n;
+  cacheEntry * slots;
+} scoreCache;
+
+uint64_t stringHash(char *);
+scoreCache * openScoreCache(char *, int, int);
+bool cacheLookup(scoreCache *, uint64_t, uint64_t, int *);
+void cacheInsert(scoreCache *, uint64_t, uint64_t, int);
+void closeScoreCache(scoreCache *);
+
+#endif
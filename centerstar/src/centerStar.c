@@ -9,141 +9,203 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
-//#define DEBUG
-
-int globalAlignment(char *, char *, int, int, int, char **);
-uint32_t minSequenceDistance(char **, uint32_t, int, int);
-uint32_t centerStar(char **, uint32_t, int, int, char **);
+#include "centerStar.h"
 
-#define SEEN    0x8
-#define LEFT    0x4
-#define UPLEFT  0x2
-#define UP      0x1
+//#define DEBUG
 
 
+// center_star [options] alpha beta file: the center star MSA of every record
+// of the file. ctx holds the inputs of a chain, or is NULL.
+int centerStarCommand(int argc, char ** argv, chainContext * ctx) {
+  argc = statsOption(argc, argv);
+
+  // the number of threads defaults to one per core
+  long nCores = sysconf(_SC_NPROCESSORS_ONLN);
+  starOptions opts = { nCores > 0 ? nCores : 1, false, false, NULL };
+  char * cachePath = NULL; // file to keep pairwise scores in between runs
+
+  // consume the option flags. A negative number is a score, not a flag.
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-' && argv[argi][1] >= 'a'; argi++) {
+    if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) {
+      int t = atoi(argv[++argi]);
+      opts.nThreads = t > 0 ? t : 1;
+    } else if (strcmp(argv[argi], "-s") == 0) {
+      opts.sketch = true;
+    } else if (strcmp(argv[argi], "-p") == 0) {
+      opts.prune = true;
+    } else if (strcmp(argv[argi], "-c") == 0 && argi + 1 < argc) {
+      cachePath = argv[++argi];
+    } else {
+      fprintf(stdout, "unknown option %s\n", argv[argi]);
+      return 1;
+    }
+  }
+  argc -= argi - 1;
+  argv += argi - 1;
 
-int main(int argc, char ** argv) {
   // early return if there aren't enough arguments
   if (argc != 4) {
     fprintf(stdout, "expected three arguments: alpha, beta, and a filepath\n");
-    return 0;
+    return 1;
   }
 
   // convert first 3 arguments to numbers
   int alpha = atoi(argv[1]);
   int beta = atoi(argv[2]);
 
-  char * s = NULL;   // the pointer to the entire char buffer
-  FILE * pFile = fopen(argv[3], "r"); // pointer to the given file
-  if (pFile == NULL) {
-    fprintf(stderr, "error reading file at %s\n", argv[4]);
+  // every record of the file is one string
+  uint64_t t0 = statsStart();
+  seqSet * set = loadSeqSet(ctx, argv[3]);
+  statsStop(PHASE_LOAD, t0);
+  if (set == NULL) return 1;
+  if (set->n == 0) {
+    fprintf(stdout, "malformed file at %s\n", argv[3]);
+    if (!ctx) freeSeqSet(set);
     return 1;
   }
-
-  fseek(pFile, 0L, SEEK_END);
-  size_t fsize = ftell(pFile); // the size of the file
-  fseek(pFile, 0L, SEEK_SET);
-
-  // We will now read the file into the text string
-  s = malloc(fsize);
-  
-  char ** t = malloc(sizeof(char *) * 100); // array of string pointers
-  uint32_t c_t = 0; // counter for the pointers
-  char * next = s; // pointer to the next write position in the string
-
-  while (!feof(pFile)) {
-    // the upper bound to read characters into the text string
-    size_t n = fsize - (next - s);
-
-    // read the next file line into the text string at 'next'
-    getline(&next, &n, pFile);
-
-    // find the next instance of \n, \r, >, or ';', and set that to next
-    // This will have the effect of overwriting the string starting at any
-    // of these characters. This will erase comments, and will remove the 
-    // carriage returns or newline characters.
-    next = strpbrk(next, "\n\r>;");
-
-    // if the S string has had data read into it and we see a comment, then we 
-    // start reading into the T string. Note that T is just a pointer into the 
-    // buffer at S.
-    if (next[0] == '>') {
-      if (c_t >= 100) {
-        fprintf(stdout, "This program does not support processing more than 100 strings\n");
-        free(s);
-        free(t);
-        return 0;
-      }
-      next[0] = 0;
-      if (next != s) next += 1; // we don't want to do this if it's the beginning
-      t[c_t++] = next;
-    }
+  uint32_t c_t = set->n; // the number of strings
+  char ** t = malloc(sizeof(char *) * (c_t + 1)); // array of string pointers
+  for (uint32_t i = 0; i < c_t; i++) {
+    t[i] = set->rec[i].seq;
   }
-  
-  // sets the final newline/carriage return to 0 if it exists.
-  if (next) next[0] = 0;
 
-  char * aligns [c_t];
-  memset(aligns, 0, sizeof(char *) * c_t);
   //globalAlignment(s, t, match, mismatch, indel, &align);
-  uint32_t c = centerStar(t, c_t, alpha, beta, aligns);
+  if (cachePath) {
+    opts.cache = openScoreCache(cachePath, alpha, beta);
+    if (!opts.cache) {
+      free(t);
+      if (!ctx) freeSeqSet(set);
+      return 1;
+    }
+  }
+  starMsa * msa = centerStar(t, c_t, alpha, beta, &opts);
+  closeScoreCache(opts.cache);
 
+  // each row is written straight from its gap runs
+  t0 = statsStart();
   int width = (int) log10(c_t) + 1;
   fprintf(stdout, "Alignment for strings 1-%d:\n", c_t);
   for (uint32_t i = 0; i < c_t; i++) {
-    fprintf(stdout, "%*d: %s", width, i + 1, aligns[i]);
-    if (i == c) fprintf(stdout, " *");
+    fprintf(stdout, "%*d: ", width, i + 1);
+    writeMsaRow(stdout, msa, i);
+    if (i == msa->c) fprintf(stdout, " *");
     fprintf(stdout, "\n");
   }
-  if (aligns) {
-    for (uint32_t i = 0; i < c_t; i++) {
-      if (aligns[i]) free(aligns[i]);
+  statsStop(PHASE_MERGE, t0);
+  freeStarMsa(msa);
+  free(t);
+  if (!ctx) freeSeqSet(set);
+  return 0;
+}
+
+// shared state for aligning the center against every string
+typedef struct centerRow_S {
+  char **          pStrings;
+  uint32_t         c;
+  int              alpha;
+  int              beta;
+  starAlignment *  aligns;
+} centerRow;
+
+// counts the runs of a gap character in a gapped string
+static uint32_t countRuns(char * row, size_t n) {
+  uint32_t runs = 0;
+  for (size_t k = 0; k < n; k++) {
+    if (row[k] == '_' && (k == 0 || row[k - 1] != '_')) runs++;
+  }
+  return runs;
+}
+
+// turns a pair of gapped strings, the center's above the other's, into the
+// runs of gaps on either side. Every run is placed by the number of center
+// characters before it.
+static void toGapRuns(char * Sa, char * Ta, starAlignment * a) {
+  size_t n = strlen(Sa);
+  a->nIns = countRuns(Sa, n);
+  a->nDel = countRuns(Ta, n);
+  a->ins = malloc(sizeof(gapRun) * (a->nIns ? a->nIns : 1));
+  a->del = malloc(sizeof(gapRun) * (a->nDel ? a->nDel : 1));
+  uint32_t nIns = 0;
+  uint32_t nDel = 0;
+  uint32_t j = 0; // center characters so far
+  for (size_t k = 0; k < n; k++) {
+    if (Sa[k] == '_') {
+      if (k == 0 || Sa[k - 1] != '_') a->ins[nIns++] = (gapRun) { j, 0 };
+      a->ins[nIns - 1].len++;
+      continue;
+    }
+    if (Ta[k] == '_') {
+      if (k == 0 || Ta[k - 1] != '_') a->del[nDel++] = (gapRun) { j, 0 };
+      a->del[nDel - 1].len++;
     }
+    j++;
   }
-  free(s);
-  return 0;
 }
 
-// The center star algorithm
-uint32_t centerStar(
+static void alignToCenter(void * ctx, uint32_t i, dpArena * arena) {
+  centerRow * row = ctx;
+  char * Sc = row->pStrings[row->c];
+  // the center aligns to itself without any gaps
+  if (i == row->c) {
+    row->aligns[i] = (starAlignment) { NULL, 0, NULL, 0 };
+    return;
+  }
+  char * pAlignment = NULL;
+  arenaReset(arena);
+  globalAlignment(Sc, row->pStrings[i], 0, -row->alpha, -row->beta, PREFER_GAP, arena, &pAlignment);
+  char * Ta = strchr(pAlignment, '\n');
+  *Ta++ = 0;
+  toGapRuns(pAlignment, Ta, &row->aligns[i]);
+}
+
+// The center star algorithm. Each pairwise alignment with the center is kept
+// only as its runs of gaps, and the widest insert before each center
+// character is taken from those runs in one pass. Rows are written out one
+// at a time by writeMsaRow, so the full MSA is never held in memory.
+starMsa * centerStar(
   char **          pStrings, 
   uint32_t         nStrings, 
   int              alpha, 
   int              beta, 
-  char **          pReturnString) 
+  starOptions *    opts) 
 
 {
-  uint32_t c = minSequenceDistance(pStrings, nStrings, alpha, beta);
-  // Get the alignments for Sc
-  char * pAlignments [nStrings];
-  for (uint32_t i; i < nStrings; i++) {
-    globalAlignment(pStrings[c], pStrings[i], 0, -alpha, -beta, &pAlignments[i]);
-  }
-  size_t nSc = strlen(pStrings[c]);
-
-#ifdef DEBUG
-  fprintf(stdout, "%d\n", nStrings);
-  for (uint32_t i = 0; i < nStrings; i++) {
-    fprintf(stdout, "%p\n", pAlignments[i]);
-    fprintf(stdout, "%s\n", pAlignments[i]);
+  uint64_t t0 = statsStart();
+  uint32_t c;
+  if (opts->sketch) {
+    c = sketchCenter(pStrings, nStrings, alpha, beta, opts->nThreads);
+  } else if (opts->prune && alpha >= 0 && beta >= 0) {
+    c = prunedCenter(pStrings, nStrings, alpha, beta, opts);
+  } else {
+    c = minSequenceDistance(pStrings, nStrings, alpha, beta, opts);
   }
-#endif
+  statsStop(PHASE_CENTER, t0);
+  // Get the alignments for Sc. Only the center's own row is traced back; the
+  // rest of the distance table was scored without keeping the matrices.
+  starMsa * msa = malloc(sizeof(starMsa));
+  msa->pStrings = pStrings;
+  msa->nStrings = nStrings;
+  msa->c = c;
+  msa->nSc = strlen(pStrings[c]);
+  msa->aligns = malloc(sizeof(starAlignment) * nStrings);
+  centerRow row = { pStrings, c, alpha, beta, msa->aligns };
+  starParallelFor(nStrings, opts->nThreads, alignToCenter, &row);
+  size_t nSc = msa->nSc;
 
   // Get the insert counts in Sc
-  uint32_t * pnInserts = malloc(sizeof(uint32_t) * nSc + 1);
-  memset(pnInserts, 0, sizeof(uint32_t) * nSc + 1);
+  t0 = statsStart();
+  uint32_t * pnInserts = calloc(nSc + 1, sizeof(uint32_t));
   for (uint32_t i = 0; i < nStrings; i++) {
-    uint32_t cLineInserts = 0;
-    for (size_t j = 0; j <= nSc; j++) {
-      uint32_t cCharInserts = 0;
-      while (pAlignments[i][j + cLineInserts + cCharInserts] == '_') {
-        cCharInserts++;
-      }
-      if (cCharInserts > pnInserts[j]) pnInserts[j] = cCharInserts;
-      cLineInserts += cCharInserts;
+    starAlignment * a = &msa->aligns[i];
+    for (uint32_t k = 0; k < a->nIns; k++) {
+      if (a->ins[k].len > pnInserts[a->ins[k].pos]) pnInserts[a->ins[k].pos] = a->ins[k].len;
     }
   }
+  msa->pnInserts = pnInserts;
 
 #ifdef DEBUG
   fprintf(stdout, "[");
@@ -154,51 +216,126 @@ uint32_t centerStar(
 #endif
 
   // Get the number of inserts that will be made in Sc
-  uint32_t cInserts = 0;
+  size_t cInserts = 0;
   for (uint32_t i = 0; i <= nSc; i++) {
     cInserts += pnInserts[i];
   }
+  msa->width = cInserts + nSc;
+  statsStop(PHASE_MERGE, t0);
 
 #ifdef DEBUG
   fprintf(stdout, "%d\n", cInserts);
 #endif
+  return msa;
+}
 
-  // Write the strings with the inserts
-  uint32_t lenSA = cInserts + nSc + 1;
-  for (uint32_t i = 0; i < nStrings; i++) {
-    pReturnString[i] = malloc(sizeof(char) * lenSA);
-    char * pos_Ai = pAlignments[i];
-    char * pos_Si = strpbrk(pos_Ai, "\n") + 1;
-    uint32_t inserts = 0;
-    for (uint32_t j = 0; j < nSc + 1; j++) {
-      // Write characters if insert is expected; otherwise write insert
-      for (uint32_t k = 0; k < pnInserts[j]; k++) {
-        if (*pos_Ai == '_') {
-          pReturnString[i][j + inserts + k] = *pos_Si;
-          pos_Si++;
-          pos_Ai++;
-        } else {
-          pReturnString[i][j + inserts + k] = '_';
-        }
-      }
-      inserts += pnInserts[j];
-      // Write the characters
-      char c = *pos_Si;
-      if (j == nSc) c = 0;
-      pReturnString[i][j + inserts] = c;
-      pos_Si++;
-      pos_Ai++;
+// Writes row i of the MSA. Before each center character go the row's own
+// inserted characters, padded to the widest insert there, and then the
+// row's character for that center character, or a gap where it has none.
+void writeMsaRow(FILE * pFile, starMsa * msa, uint32_t i) {
+  char * Si = msa->pStrings[i];
+  starAlignment * a = &msa->aligns[i];
+  uint32_t nextIns = 0;
+  uint32_t nextDel = 0;
+  size_t pos_Si = 0;
+  for (size_t j = 0; j <= msa->nSc; j++) {
+    uint32_t inserted = 0;
+    if (nextIns < a->nIns && a->ins[nextIns].pos == j) {
+      inserted = a->ins[nextIns++].len;
+      fwrite(Si + pos_Si, sizeof(char), inserted, pFile);
+      pos_Si += inserted;
+    }
+    for (uint32_t k = inserted; k < msa->pnInserts[j]; k++) {
+      putc('_', pFile);
+    }
+    if (j == msa->nSc) break;
+
+    // a deleted center character is a gap in this row
+    if (nextDel < a->nDel && a->del[nextDel].pos <= j) {
+      putc('_', pFile);
+      if (j + 1 == a->del[nextDel].pos + a->del[nextDel].len) nextDel++;
+    } else {
+      putc(Si[pos_Si++], pFile);
     }
-#ifdef DEBUG
-    fprintf(stdout, "%s\n", *pReturnString);
-#endif
   }
+}
 
-#ifdef DEBUG
-  fprintf(stdout, "%p\n", *pReturnString);
-  fprintf(stdout, "%s\n", *pReturnString);
-#endif
-  return c;
+void freeStarMsa(starMsa * msa) {
+  for (uint32_t i = 0; i < msa->nStrings; i++) {
+    free(msa->aligns[i].ins);
+    free(msa->aligns[i].del);
+  }
+  free(msa->aligns);
+  free(msa->pnInserts);
+  free(msa);
+}
+
+// packs every string, or returns NULL if any of them isn't worth packing
+packedSeq ** packStrings(char ** pStrings, uint32_t nStrings) {
+  uint64_t t0 = statsStart();
+  for (uint32_t i = 0; i < nStrings; i++) {
+    if (!worthPacking(pStrings[i], strlen(pStrings[i]))) return NULL;
+  }
+  packedSeq ** packed = malloc(sizeof(packedSeq *) * nStrings);
+  for (uint32_t i = 0; i < nStrings; i++) {
+    packed[i] = packSeq(pStrings[i], strlen(pStrings[i]));
+  }
+  statsStop(PHASE_PACK, t0);
+  return packed;
+}
+
+void freePackedStrings(packedSeq ** packed, uint32_t nStrings) {
+  if (!packed) return;
+  for (uint32_t i = 0; i < nStrings; i++) {
+    freePackedSeq(packed[i]);
+  }
+  free(packed);
+}
+
+// the lengths of the prefix and the suffix two strings share, compared a word
+// of bases at a time. When matches score 0 and nothing else scores above 0,
+// some best alignment matches the shared ends, so only what lies between
+// them needs the DP.
+void sharedEnds(packedSeq * a, packedSeq * b, size_t * pPre, size_t * pSuf) {
+  size_t m = a->n < b->n ? a->n : b->n;
+  *pPre = packedPrefixMatch(a, 0, b, 0, m);
+  *pSuf = packedSuffixMatch(a, a->n, b, b->n, m - *pPre);
+}
+
+// shared state for filling the distance table
+typedef struct distanceTable_S {
+  char **          pStrings;
+  packedSeq **     packed;
+  uint32_t         nStrings;
+  int              alpha;
+  int              beta;
+  int *            T;
+} distanceTable;
+
+// marks a distance that wasn't found in the score cache
+#define UNSCORED INT32_MIN
+
+// scores row i of the table against every string after it, skipping the
+// pairs already filled from the cache. Only the upper half is written here.
+static void scoreRow(void * ctx, uint32_t i, dpArena * arena) {
+  distanceTable * dt = ctx;
+  size_t n = dt->nStrings;
+  for (size_t j = i + 1; j < n; j++) {
+    if (dt->T[i * n + j] != UNSCORED) continue;
+    char * a = dt->pStrings[i];
+    char * b = dt->pStrings[j];
+    size_t na, nb, pre = 0, suf = 0;
+    if (dt->packed) {
+      na = dt->packed[i]->n;
+      nb = dt->packed[j]->n;
+      sharedEnds(dt->packed[i], dt->packed[j], &pre, &suf);
+    } else {
+      na = strlen(a);
+      nb = strlen(b);
+    }
+    arenaReset(arena);
+    dt->T[i * n + j] = -alignmentScore(a + pre, na - pre - suf, b + pre, nb - pre - suf, 0, -dt->alpha, -dt->beta, arena);
+  }
 }
 
 // Finds the minimum sequence and prints the sequence distance table
@@ -206,18 +343,51 @@ uint32_t minSequenceDistance(
   char **          pStrings, 
   uint32_t         nStrings, 
   int              alpha, 
-  int              beta) 
+  int              beta,
+  starOptions *    opts) 
 
 {
-  int T[nStrings][nStrings];
+  int (* T)[nStrings] = calloc((size_t) nStrings * nStrings, sizeof(int));
   int places = 0;
+
+  // take what pairs we can from the cache, and mark the rest to be scored
+  uint64_t * hashes = NULL;
+  if (opts->cache) {
+    hashes = malloc(sizeof(uint64_t) * nStrings);
+    for (uint32_t i = 0; i < nStrings; i++) {
+      hashes[i] = stringHash(pStrings[i]);
+    }
+  }
+  for (uint32_t i = 0; i < nStrings; i++) {
+    for (uint32_t j = i + 1; j < nStrings; j++) {
+      int score;
+      if (hashes && cacheLookup(opts->cache, hashes[i], hashes[j], &score)) {
+        T[i][j] = -score;
+        T[j][i] = -score;
+      } else {
+        T[i][j] = UNSCORED;
+        T[j][i] = UNSCORED;
+      }
+    }
+  }
   
-  // build the table
-  memset(T, 0, sizeof(int) * nStrings * nStrings);
+  // build the table, one row per task
+  packedSeq ** packed = alpha >= 0 && beta >= 0 ? packStrings(pStrings, nStrings) : NULL;
+  distanceTable dt = { pStrings, packed, nStrings, alpha, beta, (int *) T };
+  starParallelFor(nStrings, opts->nThreads, scoreRow, &dt);
+  freePackedStrings(packed, nStrings);
+
+  // mirror the new scores into the lower half, saving them as we go
+  for (uint32_t i = 0; i < nStrings; i++) {
+    for (uint32_t j = i + 1; j < nStrings; j++) {
+      if (T[j][i] != UNSCORED) continue;
+      T[j][i] = T[i][j];
+      if (hashes) cacheInsert(opts->cache, hashes[i], hashes[j], -T[i][j]);
+    }
+  }
+  free(hashes);
   for (int i = 0; i < nStrings; i++) {
     for (int j = i+1; j < nStrings; j++) {
-      T[i][j] = -globalAlignment(pStrings[i], pStrings[j], 0, -alpha, -beta, NULL);
-      T[j][i] = T[i][j];
       // while we're here, we'll get information for formatting
       int p = (int) log10(T[i][j]) + 1;
       places = p > places ? p : places;
@@ -253,150 +423,78 @@ uint32_t minSequenceDistance(
     fprintf(stdout, "\n");
   }
   fprintf(stdout, "\n");
+  free(T);
   return idx;
 }
 
-int globalAlignment(
+// runs fn on every task in [0, nTasks) across nThreads threads, the calling
+// thread included. Tasks are taken in order as threads free up, and each
+// thread keeps its own arena for all the tasks it runs.
+static void * poolWorker(void * arg) {
+  taskPool * pool = arg;
+  dpArena arena = { NULL, 0, 0 };
+  uint32_t t;
+  while ((t = atomic_fetch_add(&pool->next, 1)) < pool->nTasks) {
+    pool->fn(pool->ctx, t, &arena);
+  }
+  freeArena(&arena);
+  return NULL;
+}
+
+void starParallelFor(uint32_t nTasks, uint32_t nThreads, taskFn fn, void * ctx) {
+  taskPool pool = { .fn = fn, .ctx = ctx, .nTasks = nTasks };
+  atomic_init(&pool.next, 0);
+  if (nThreads > nTasks) nThreads = nTasks;
+  if (nThreads == 0) return;
+  pthread_t threads [nThreads];
+  for (uint32_t i = 1; i < nThreads; i++) {
+    pthread_create(&threads[i], NULL, poolWorker, &pool);
+  }
+  poolWorker(&pool);
+  for (uint32_t i = 1; i < nThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+// the score of the global alignment of the first nStr1 characters of str1 and
+// the first nStr2 of str2, without the alignment.
+// Only one row of the V matrix is kept, in the caller's arena. Under unit
+// costs the bit-parallel edit distance is used instead.
+int alignmentScore(
   char *           str1, 
+  size_t           nStr1, 
   char *           str2, 
+  size_t           nStr2, 
   int              match, 
   int              mismatch, 
   int              indel, 
-  char **          pRetStr)
+  dpArena *        arena)
 
 {
-  // get the number of characters in S and T
-  size_t nStr1 = strlen(str1);
-  size_t nStr2 = strlen(str2);
-
-  // create the V matrix
-  int V[nStr1+ 1][nStr2 + 1];
-  for (int x = 0; x < nStr1 + 1; x++) {
-    for (int y = 0; y < nStr2 + 1; y++) {
-      if (x == 0 && y == 0) {
-        V[x][y] = 0;
-      } else if (x == 0) {
-        V[x][y] = V[x][y - 1] + indel;
-      } else if (y == 0) {
-        V[x][y] = V[x - 1][y] + indel;
-      } else {
-        int u = V[x - 1][y] + indel;
-        int l = V[x][y - 1] + indel;
-        int ul = V[x - 1][y - 1] + (str1[x - 1] == str2[y - 1] ? match : mismatch);
-        V[x][y] = (u > l ? (u > ul ? u : ul) : (l > ul ? l : ul));
-      }
-    }
+  uint64_t t0 = statsStart();
+  if (unitCosts(match, mismatch, indel)) {
+    int d = editDistance(str1, nStr1, str2, nStr2, EDIT_NO_CUTOFF, arena, NULL);
+    statsStop(PHASE_DP_FILL, t0);
+    return d * indel;
   }
-  // If there isn't a string to print to, return the score here
-  if (pRetStr == NULL) return V[nStr1][nStr2];
-
-#ifdef DEBUG
-  // Print out the V matrix for debugging
-  fprintf(stdout, " % 4c", '_');
-  for (int y = 0; y < nStr2 + 1; y++) 
-    fprintf(stdout, "% 4c", str2[y]);
-  fprintf(stdout, "\n");
-  for (int x = 0; x < nStr1 + 1; x++) {
-    if (x == 0) fprintf(stdout, "_");
-    else fprintf(stdout, "%c", str1[x - 1]);
-    for (int y = 0; y < nStr2 + 1; y++) {
-      fprintf(stdout, "% 4d", V[x][y]);
-    }
-    fprintf(stdout, "\n");
+  statsAdd(COUNT_DP_CELLS, (uint64_t) (nStr1 + 1) * (nStr2 + 1));
+  int * V = arenaAlloc(arena, sizeof(int) * (nStr2 + 1));
+  for (size_t y = 0; y < nStr2 + 1; y++) {
+    V[y] = (int) y * indel;
   }
-#endif
-  
-  //tabulate all paths
-  char V_b[nStr1 + 1][nStr2 + 1];
-  memset(V_b, 0, (nStr1 + 1) * (nStr2 + 1));
-  V_b[nStr1][nStr2] = SEEN;
-  for (int x = nStr1; x >= 0; x--) {
-    for (int y = nStr2; y >= 0; y--) {
-      if (!(V_b[x][y] & SEEN)) continue;
-      if (x == 0 && y == 0) break;
-      if (x == 0) {
-        V_b[x][y] = LEFT;
-        V_b[x][y - 1] = SEEN;
-      } else if (y == 0) {
-        V_b[x][y] = UP;
-        V_b[x - 1][y] = SEEN;
-      } else {
-        if (
-          V[x - 1][y - 1] + match == V[x][y] && str1[x - 1] == str2[y - 1] ||
-          V[x - 1][y - 1] + mismatch == V[x][y] && str1[x - 1] != str2[y - 1]
-        ) {
-          V_b[x][y] = UPLEFT;
-          V_b[x - 1][y - 1] = SEEN;
-        }
-        if (V[x][y - 1] + indel == V[x][y]) {
-          V_b[x][y] += LEFT;
-          V_b[x][y - 1] = SEEN;
-        }
-        if (V[x - 1][y] + indel == V[x][y]) {
-          V_b[x][y] += UP;
-          V_b[x - 1][y] = SEEN;
-        }
-      }
+  for (size_t x = 1; x < nStr1 + 1; x++) {
+    // V[y] still holds the row above until it is overwritten, and ul holds
+    // the cell above and to the left
+    int ul = V[0];
+    V[0] = (int) x * indel;
+    for (size_t y = 1; y < nStr2 + 1; y++) {
+      int u = V[y] + indel;
+      int l = V[y - 1] + indel;
+      int d = ul + (str1[x - 1] == str2[y - 1] ? match : mismatch);
+      ul = V[y];
+      V[y] = (u > l ? (u > d ? u : d) : (l > d ? l : d));
     }
   }
-
-
-#ifdef DEBUG
-  for (int x = 0; x < nStr1 + 1; x++) {
-    for (int y = 0; y < nStr2 + 1; y++) {
-      if (x == 0 && y == 0) fprintf(stdout, "% 4c", '*');
-      else {
-        char directions[4] = {
-          V_b[x][y] & LEFT      ? 'L' : '-',
-          V_b[x][y] & UPLEFT    ? 'D' : '-',
-          V_b[x][y] & UP        ? 'U' : '-',
-          0
-        };
-        fprintf(stdout, "% 4s", directions);
-      }
-    }
-    fprintf(stdout, "\n");
-  }
-#endif
-
-  // create the alignment
-  char Sa[nStr1 + nStr2 + 1];
-  char Ta[nStr1 + nStr2 + 1];
-  uint32_t x = 0;
-  uint32_t y = 0;
-  uint32_t i = 0;
-  while (x < nStr1 || y < nStr2) {
-    if (x == nStr1) {
-      Sa[i] = '_';
-      Ta[i] = str2[y];
-      y++;
-    } else if (y == nStr2) {
-      Sa[i] = str1[x];
-      Ta[i] = '_';
-      x++;
-    } else {
-      if (V_b[x][y + 1] & LEFT) {
-        Sa[i] = '_';
-        Ta[i] = str2[y];
-        y++;
-      } else if (V_b[x + 1][y] & UP) {
-        Sa[i] = str1[x];
-        Ta[i] = '_';
-        x++;
-      } else if (V_b[x + 1][y + 1] & UPLEFT) {
-        Sa[i] = str1[x];
-        Ta[i] = str2[y];
-        x++;
-        y++;
-      }
-    }
-    i++;
-  }
-  Sa[i] = 0;
-  Ta[i] = 0;
-
-  * pRetStr = malloc(strlen(Sa) + strlen(Ta) + 2);
-  sprintf(* pRetStr, "%s\n%s", Sa, Ta);
-
-  return V[nStr1][nStr2];
+  statsStop(PHASE_DP_FILL, t0);
+  return V[nStr2];
 }
@@ -0,0 +1,11 @@
+/**********************************************************************
+ * stand-alone entry point for center_star                            *
+ * main.c                                                             *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include "centerStar.h"
+
+int main(int argc, char ** argv) {
+  return centerStarCommand(argc, argv, NULL);
+}
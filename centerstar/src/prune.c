@@ -0,0 +1,259 @@
+/**********************************************************************
+ * exact center selection by branch and bound                         *
+ * prune.c                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "centerStar.h"
+
+#define INF (INT_MAX / 2)
+#define UNSCORED -1
+
+typedef struct candidate_S {
+  uint32_t         idx;
+  int64_t          bound;
+} candidate;
+
+/**
+ * Helper functions
+ */
+
+static int compareBound(const void * a, const void * b) {
+  const candidate * x = a;
+  const candidate * y = b;
+  if (x->bound != y->bound) return (x->bound > y->bound) - (x->bound < y->bound);
+  return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+
+/**
+ * primary calls
+ */
+
+// the distance of the global alignment of the first nStr1 characters of str1
+// and the first nStr2 of str2, under mismatch cost
+// alpha and indel cost beta, if it is at most cutoff. Otherwise some value
+// over cutoff is returned as soon as that is certain.
+//
+// Every cell off the main diagonals costs at least beta per step away from
+// them, both to reach and to leave, so only a band of diagonals can hold a
+// path under cutoff. Costs never fall along a path, so the alignment is
+// abandoned once a whole row of the band is over cutoff. The number of
+// cells filled is added to pCells. Under unit costs the bit-parallel edit
+// distance is used instead, abandoned once the last row is too far over
+// cutoff to come back under it.
+int boundedDistance(
+  char *           str1,
+  size_t           nStr1,
+  char *           str2,
+  size_t           nStr2,
+  int              alpha,
+  int              beta,
+  int64_t          cutoff,
+  dpArena *        arena,
+  uint64_t *       pCells)
+
+{
+  int n1 = nStr1;
+  int n2 = nStr2;
+  int D = n2 - n1;
+  int absD = D < 0 ? -D : D;
+  if (unitCosts(0, -alpha, -beta)) {
+    int64_t edits = editDistance(str1, nStr1, str2, nStr2, cutoff / beta, arena, pCells);
+    return edits > cutoff / beta ? cutoff + 1 : edits * beta;
+  }
+
+  // the band of diagonals y - x in [dlo, dhi]
+  int dlo = -n1;
+  int dhi = n2;
+  if (beta > 0 && cutoff < INF) {
+    if ((int64_t) absD * beta > cutoff) return cutoff + 1;
+    int64_t extra = (cutoff / beta - absD) / 2;
+    if (extra < n1 + n2) {
+      dlo = (D < 0 ? D : 0) - extra;
+      dhi = (D > 0 ? D : 0) + extra;
+    }
+  }
+
+  int * V = arenaAlloc(arena, sizeof(int) * (n2 + 2));
+  for (int y = 0; y <= n2; y++) {
+    V[y] = y <= dhi ? y * beta : INF;
+  }
+  *pCells += (dhi < n2 ? dhi : n2) + 1;
+
+  for (int x = 1; x <= n1; x++) {
+    int ylo = x + dlo > 0 ? x + dlo : 0;
+    int yhi = x + dhi < n2 ? x + dhi : n2;
+    int diag, left;
+    if (ylo == 0) {
+      diag = V[0];
+      left = V[0] = x * beta;
+      ylo = 1;
+    } else {
+      diag = V[ylo - 1];
+      left = INF;
+    }
+    int rowMin = left;
+    char c = str1[x - 1];
+    for (int y = ylo; y <= yhi; y++) {
+      int up = V[y];
+      int cur = diag + (c == str2[y - 1] ? 0 : alpha);
+      if (up + beta < cur) cur = up + beta;
+      if (left + beta < cur) cur = left + beta;
+      diag = up;
+      left = cur;
+      V[y] = cur;
+      if (cur < rowMin) rowMin = cur;
+    }
+    // the next row must not see this row's stale cell past the band
+    if (yhi + 1 <= n2) V[yhi + 1] = INF;
+    *pCells += yhi - ylo + 1 + (x + dlo <= 0);
+    if (rowMin > cutoff) return cutoff + 1;
+  }
+  return V[n2] > cutoff ? cutoff + 1 : V[n2];
+}
+
+// Finds the center exactly without filling the whole distance table. The
+// candidates are tried in order of the sum of their cheapest possible
+// distances, beta times each difference in length. A candidate is dropped as
+// soon as its distances so far, plus the bounds on the rest, can't beat the
+// best row sum found, and each alignment is given only what is left of that
+// budget, after the ends the pair shares are taken off. Distances and
+// tightened bounds are shared between the two strings of a pair, and each row
+// that is finished exactly bounds every other pair through the triangle
+// inequality. Ties go to the lower index, as in minSequenceDistance.
+uint32_t prunedCenter(
+  char **          pStrings,
+  uint32_t         nStrings,
+  int              alpha,
+  int              beta,
+  starOptions *    opts)
+
+{
+  size_t n = nStrings;
+  int * dist = malloc(sizeof(int) * n * n);
+  int * bound = malloc(sizeof(int) * n * n);
+  int * len = malloc(sizeof(int) * n);
+  for (size_t i = 0; i < n; i++) {
+    len[i] = strlen(pStrings[i]);
+  }
+
+  packedSeq ** packed = packStrings(pStrings, nStrings);
+  uint64_t * hashes = NULL;
+  if (opts->cache) {
+    hashes = malloc(sizeof(uint64_t) * n);
+    for (size_t i = 0; i < n; i++) {
+      hashes[i] = stringHash(pStrings[i]);
+    }
+  }
+
+  // start from the length bounds, and whatever the cache already knows
+  uint64_t fullCells = 0;
+  candidate * cand = malloc(sizeof(candidate) * n);
+  for (size_t i = 0; i < n; i++) {
+    cand[i] = (candidate) { i, 0 };
+  }
+  for (size_t i = 0; i < n; i++) {
+    dist[i * n + i] = 0;
+    bound[i * n + i] = 0;
+    for (size_t j = i + 1; j < n; j++) {
+      int d = len[i] > len[j] ? len[i] - len[j] : len[j] - len[i];
+      int score;
+      bound[i * n + j] = bound[j * n + i] = d * beta;
+      dist[i * n + j] = dist[j * n + i] = UNSCORED;
+      if (hashes && cacheLookup(opts->cache, hashes[i], hashes[j], &score)) {
+        dist[i * n + j] = dist[j * n + i] = -score;
+        bound[i * n + j] = bound[j * n + i] = -score;
+      }
+      cand[i].bound += bound[i * n + j];
+      cand[j].bound += bound[i * n + j];
+      fullCells += (uint64_t) (len[i] + 1) * (len[j] + 1);
+    }
+  }
+  qsort(cand, n, sizeof(candidate), compareBound);
+
+  dpArena arena = { NULL, 0, 0 };
+  uint64_t cells = 0;
+  int64_t best = INT64_MAX;
+  size_t bestIdx = n;
+  for (size_t k = 0; k < n; k++) {
+    size_t i = cand[k].idx;
+    // a later index has to beat the best outright to win. The first
+    // candidate has no budget, so it is always scored in full.
+    int64_t allowed = best == INT64_MAX ? INT64_MAX : (i < bestIdx ? best : best - 1);
+    int64_t rest = 0;
+    for (size_t j = 0; j < n; j++) {
+      rest += bound[i * n + j];
+    }
+    if (rest > allowed) continue;
+
+    int64_t partial = 0;
+    bool pruned = false;
+    for (size_t j = 0; j < n && !pruned; j++) {
+      if (j == i) continue;
+      rest -= bound[i * n + j];
+      int d = dist[i * n + j];
+      if (d == UNSCORED) {
+        int64_t cutoff = allowed - partial - rest;
+        if (cutoff > INF) cutoff = INF;
+        size_t pre = 0, suf = 0;
+        if (packed) sharedEnds(packed[i], packed[j], &pre, &suf);
+        uint64_t t0 = statsStart();
+        arenaReset(&arena);
+        d = boundedDistance(pStrings[i] + pre, len[i] - pre - suf, pStrings[j] + pre, len[j] - pre - suf,
+          alpha, beta, cutoff, &arena, &cells);
+        statsStop(PHASE_DP_FILL, t0);
+        if (d <= cutoff) {
+          dist[i * n + j] = dist[j * n + i] = d;
+          bound[i * n + j] = bound[j * n + i] = d;
+          if (hashes) cacheInsert(opts->cache, hashes[i], hashes[j], -d);
+        } else if (d > bound[i * n + j]) {
+          bound[i * n + j] = bound[j * n + i] = d;
+        }
+      }
+      partial += d;
+      if (partial + rest > allowed) pruned = true;
+    }
+    if (pruned) continue;
+    best = partial;
+    bestIdx = i;
+
+    // the row of i is now exact, so by the triangle inequality every pair is
+    // at least as far apart as their distances to i differ
+    for (size_t a = 0; a < n; a++) {
+      for (size_t b = a + 1; b < n; b++) {
+        int d = dist[i * n + a] - dist[i * n + b];
+        if (d < 0) d = -d;
+        if (d > bound[a * n + b]) bound[a * n + b] = bound[b * n + a] = d;
+      }
+    }
+    for (size_t m = k + 1; m < n; m++) {
+      cand[m].bound = 0;
+      for (size_t j = 0; j < n; j++) {
+        cand[m].bound += bound[cand[m].idx * n + j];
+      }
+    }
+    qsort(cand + k + 1, n - k - 1, sizeof(candidate), compareBound);
+  }
+
+  fprintf(stdout, "Center S%d found by branch and bound, distance %lld\n", (int) bestIdx + 1, (long long) best);
+  fprintf(stdout, "DP cells filled: %llu of %llu (%.1f%%)\n\n", (unsigned long long) cells,
+    (unsigned long long) fullCells, fullCells ? 100.0 * cells / fullCells : 0.0);
+  // the bit-parallel distance is counted in dp_words as it runs
+  if (!unitCosts(0, -alpha, -beta)) statsAdd(COUNT_DP_CELLS, cells);
+
+  freeArena(&arena);
+  freePackedStrings(packed, nStrings);
+  free(hashes);
+  free(cand);
+  free(len);
+  free(bound);
+  free(dist);
+  return bestIdx;
+}
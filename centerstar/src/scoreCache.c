@@ -0,0 +1,153 @@
+/**********************************************************************
+ * on-disk cache of pairwise alignment scores                         *
+ * scoreCache.c                                                       *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "scoreCache.h"
+
+/**
+ * Helper functions
+ */
+
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// finds the slot holding the pair, or the empty slot it would go in
+static cacheEntry * findEntry(scoreCache * cache, uint64_t ha, uint64_t hb) {
+  size_t mask = cache->size - 1;
+  size_t slot = mix64(ha ^ mix64(hb)) & mask;
+  while (cache->slots[slot].used && (cache->slots[slot].ha != ha || cache->slots[slot].hb != hb)) {
+    slot = (slot + 1) & mask;
+  }
+  return &cache->slots[slot];
+}
+
+// adds a pair to the table, doubling it when it is half full
+static void putEntry(scoreCache * cache, uint64_t ha, uint64_t hb, int score) {
+  if (2 * (cache->n + 1) > cache->size) {
+    cacheEntry * old = cache->slots;
+    size_t oldSize = cache->size;
+    cache->size *= 2;
+    cache->slots = calloc(cache->size, sizeof(cacheEntry));
+    cache->n = 0;
+    for (size_t i = 0; i < oldSize; i++) {
+      if (old[i].used) putEntry(cache, old[i].ha, old[i].hb, old[i].score);
+    }
+    free(old);
+  }
+  cacheEntry * e = findEntry(cache, ha, hb);
+  if (!e->used) cache->n++;
+  *e = (cacheEntry) { ha, hb, cache->alpha, cache->beta, score, 1 };
+}
+
+
+/**
+ * primary calls
+ */
+
+// a 64 bit content hash of a string (FNV-1a, then mixed with the length)
+uint64_t stringHash(char * s) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  size_t n = 0;
+  for (; s[n]; n++) {
+    h ^= (unsigned char) s[n];
+    h *= 0x100000001b3ULL;
+  }
+  return mix64(h ^ mix64(n));
+}
+
+// loads the entries of a cache file that were scored with alpha and beta, and
+// opens it for appending. The file is created if it doesn't exist. A torn
+// entry at the end, left by a run stopped partway through a write, is cut
+// off so the entries appended after it line up.
+scoreCache * openScoreCache(char * path, int alpha, int beta) {
+  scoreCache * cache = malloc(sizeof(scoreCache));
+  cache->alpha = alpha;
+  cache->beta = beta;
+  cache->size = 1024;
+  cache->n = 0;
+  cache->slots = calloc(cache->size, sizeof(cacheEntry));
+
+  long whole = 0; // bytes up to the end of the last whole entry
+  FILE * pFile = fopen(path, "rb");
+  if (pFile) {
+    char magic [4];
+    uint32_t version;
+    if (fread(magic, sizeof(char), 4, pFile) != 4 || memcmp(magic, CACHE_MAGIC, 4) != 0 ||
+        fread(&version, sizeof(uint32_t), 1, pFile) != 1 || version != CACHE_VERSION) {
+      fprintf(stderr, "%s is not a score cache\n", path);
+      fclose(pFile);
+      free(cache->slots);
+      free(cache);
+      return NULL;
+    }
+    cacheEntry e;
+    whole = ftell(pFile);
+    while (fread(&e, sizeof(cacheEntry), 1, pFile) == 1) {
+      whole += sizeof(cacheEntry);
+      if (e.alpha == alpha && e.beta == beta) putEntry(cache, e.ha, e.hb, e.score);
+    }
+    fclose(pFile);
+  }
+
+  cache->pFile = fopen(path, "ab");
+  if (cache->pFile == NULL) {
+    fprintf(stderr, "error writing file at %s\n", path);
+    free(cache->slots);
+    free(cache);
+    return NULL;
+  }
+  fseek(cache->pFile, 0L, SEEK_END);
+  if (ftell(cache->pFile) > whole) ftruncate(fileno(cache->pFile), whole);
+  if (whole == 0) {
+    uint32_t version = CACHE_VERSION;
+    fwrite(CACHE_MAGIC, sizeof(char), 4, cache->pFile);
+    fwrite(&version, sizeof(uint32_t), 1, cache->pFile);
+  }
+  return cache;
+}
+
+// finds the saved score of the strings with hashes ha and hb
+bool cacheLookup(scoreCache * cache, uint64_t ha, uint64_t hb, int * pScore) {
+  if (ha > hb) {
+    uint64_t tmp = ha;
+    ha = hb;
+    hb = tmp;
+  }
+  cacheEntry * e = findEntry(cache, ha, hb);
+  if (!e->used) return false;
+  *pScore = e->score;
+  return true;
+}
+
+// saves the score of the strings with hashes ha and hb
+void cacheInsert(scoreCache * cache, uint64_t ha, uint64_t hb, int score) {
+  if (ha > hb) {
+    uint64_t tmp = ha;
+    ha = hb;
+    hb = tmp;
+  }
+  putEntry(cache, ha, hb, score);
+  cacheEntry e = { ha, hb, cache->alpha, cache->beta, score, 1 };
+  fwrite(&e, sizeof(cacheEntry), 1, cache->pFile);
+}
+
+void closeScoreCache(scoreCache * cache) {
+  if (!cache) return;
+  fclose(cache->pFile);
+  free(cache->slots);
+  free(cache);
+}
@@ -0,0 +1,217 @@
+/**********************************************************************
+ * center selection from k-mer sketches for large inputs              *
+ * sketch.c                                                           *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "centerStar.h"
+
+#define SKETCH_K         15  // k-mer length
+#define SKETCH_SCALE     8   // keep the k-mers whose hash is in the lowest 1/SCALE
+#define SKETCH_SHORTLIST 16  // candidates scored with exact alignments
+#define SKETCH_SAMPLE    256 // strings each candidate is aligned against
+
+// the sampled k-mer hashes of one string, sorted and distinct
+typedef struct sketch_S {
+  uint64_t * h;
+  uint32_t n;
+} sketch;
+
+typedef struct sketchSet_S {
+  char **          pStrings;
+  sketch *         sk;
+} sketchSet;
+
+typedef struct candidate_S {
+  uint32_t         idx;
+  double           shared;
+  int64_t          distance;
+} candidate;
+
+typedef struct candidateSet_S {
+  char **          pStrings;
+  uint32_t *       sample;
+  uint32_t         nSample;
+  int              alpha;
+  int              beta;
+  candidate *      cand;
+} candidateSet;
+
+/**
+ * Helper functions
+ */
+
+// spreads the bits of a rolling hash evenly (splitmix64's finalizer)
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static int compareHash(const void * a, const void * b) {
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+// most shared k-mers first, then by position for a stable order
+static int compareShared(const void * a, const void * b) {
+  const candidate * x = a;
+  const candidate * y = b;
+  if (x->shared != y->shared) return x->shared < y->shared ? 1 : -1;
+  return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+// hashes every k-mer of string i with a polynomial rolling hash and keeps the
+// fraction that falls under the threshold. The sketch outlives the task, so
+// nothing is taken from the arena.
+static void buildSketch(void * ctx, uint32_t i, dpArena * arena) {
+  (void) arena;
+  sketchSet * set = ctx;
+  char * s = set->pStrings[i];
+  size_t n = strlen(s);
+  const uint64_t B = 0x100000001b3ULL;
+  const uint64_t limit = UINT64_MAX / SKETCH_SCALE;
+  size_t k = n < SKETCH_K ? n : SKETCH_K;
+
+  uint64_t Bk = 1;
+  for (size_t j = 0; j < k; j++) Bk *= B;
+
+  uint64_t * h = malloc(sizeof(uint64_t) * (n + 1));
+  uint32_t m = 0;
+  uint64_t roll = 0;
+  for (size_t j = 0; j < n; j++) {
+    roll = roll * B + (unsigned char) s[j];
+    if (j >= k) roll -= (unsigned char) s[j - k] * Bk;
+    if (j + 1 < k) continue;
+    uint64_t v = mix64(roll);
+    if (v < limit) h[m++] = v;
+  }
+
+  // keep one copy of each hash
+  qsort(h, m, sizeof(uint64_t), compareHash);
+  uint32_t u = 0;
+  for (uint32_t j = 0; j < m; j++) {
+    if (u == 0 || h[j] != h[u - 1]) h[u++] = h[j];
+  }
+  set->sk[i].h = h;
+  set->sk[i].n = u;
+}
+
+// slot of a hash in an open addressing table of size mask + 1. A key of 0
+// marks an empty slot, so a hash of 0 is stored as 1.
+static size_t findSlot(uint64_t * keys, size_t mask, uint64_t h) {
+  if (h == 0) h = 1;
+  size_t slot = h & mask;
+  while (keys[slot] && keys[slot] != h) slot = (slot + 1) & mask;
+  keys[slot] = h;
+  return slot;
+}
+
+// the exact distance from one candidate to every sampled string
+static void scoreCandidate(void * ctx, uint32_t i, dpArena * arena) {
+  candidateSet * set = ctx;
+  candidate * c = &set->cand[i];
+  char * Sc = set->pStrings[c->idx];
+  c->distance = 0;
+  for (uint32_t j = 0; j < set->nSample; j++) {
+    if (set->sample[j] == c->idx) continue;
+    char * Sj = set->pStrings[set->sample[j]];
+    arenaReset(arena);
+    c->distance -= alignmentScore(Sc, strlen(Sc), Sj, strlen(Sj), 0, -set->alpha, -set->beta, arena);
+  }
+}
+
+
+/**
+ * primary calls
+ */
+
+// picks a center without the full distance table. Each string is ranked by
+// how many other strings share its sampled k-mers on average, which takes one
+// pass over the sketches, and only the best ranked few are aligned exactly,
+// against an evenly spaced sample of the strings. The one with the smallest
+// distance to the sample is the center.
+uint32_t sketchCenter(
+  char **          pStrings,
+  uint32_t         nStrings,
+  int              alpha,
+  int              beta,
+  uint32_t         nThreads)
+
+{
+  sketch * sk = malloc(sizeof(sketch) * nStrings);
+  sketchSet set = { pStrings, sk };
+  starParallelFor(nStrings, nThreads, buildSketch, &set);
+
+  // count the strings each sampled k-mer occurs in
+  size_t total = 0;
+  for (uint32_t i = 0; i < nStrings; i++) total += sk[i].n;
+  size_t size = 16;
+  while (size < 2 * total) size *= 2;
+  uint64_t * keys = calloc(size, sizeof(uint64_t));
+  uint32_t * counts = calloc(size, sizeof(uint32_t));
+  for (uint32_t i = 0; i < nStrings; i++) {
+    for (uint32_t j = 0; j < sk[i].n; j++) {
+      counts[findSlot(keys, size - 1, sk[i].h[j])]++;
+    }
+  }
+
+  // rank the strings by the average number of others sharing their k-mers
+  candidate * cand = malloc(sizeof(candidate) * nStrings);
+  for (uint32_t i = 0; i < nStrings; i++) {
+    double shared = 0;
+    for (uint32_t j = 0; j < sk[i].n; j++) {
+      shared += counts[findSlot(keys, size - 1, sk[i].h[j])] - 1;
+    }
+    cand[i] = (candidate) { i, sk[i].n ? shared / sk[i].n : 0, 0 };
+    free(sk[i].h);
+  }
+  free(sk);
+  free(keys);
+  free(counts);
+  qsort(cand, nStrings, sizeof(candidate), compareShared);
+
+  // score the shortlist exactly against the sample
+  uint32_t nCand = nStrings < SKETCH_SHORTLIST ? nStrings : SKETCH_SHORTLIST;
+  uint32_t nSample = nStrings < SKETCH_SAMPLE ? nStrings : SKETCH_SAMPLE;
+  uint32_t * sample = malloc(sizeof(uint32_t) * nSample);
+  for (uint32_t j = 0; j < nSample; j++) {
+    sample[j] = (uint64_t) j * nStrings / nSample;
+  }
+  candidateSet cset = { pStrings, sample, nSample, alpha, beta, cand };
+  starParallelFor(nCand, nThreads, scoreCandidate, &cset);
+
+  uint32_t best = 0;
+  for (uint32_t i = 1; i < nCand; i++) {
+    if (cand[i].distance < cand[best].distance ||
+        (cand[i].distance == cand[best].distance && cand[i].idx < cand[best].idx)) {
+      best = i;
+    }
+  }
+
+  // print the shortlist
+  int idx_width = (int) log10(nStrings) + 1;
+  fprintf(stdout, "Center chosen from %d strings by %d-mer sketch, against %d of them:\n", nStrings, SKETCH_K, nSample);
+  fprintf(stdout, "%*c  %8s %10s\n\n", idx_width, 'S', "shared", "distance");
+  for (uint32_t i = 0; i < nCand; i++) {
+    fprintf(stdout, "%*d  %8.2f %10lld", idx_width, cand[i].idx + 1, cand[i].shared, (long long) cand[i].distance);
+    if (i == best) fprintf(stdout, "  <-");
+    fprintf(stdout, "\n");
+  }
+  fprintf(stdout, "\n");
+
+  uint32_t c = cand[best].idx;
+  free(sample);
+  free(cand);
+  return c;
+}
@@ -0,0 +1,22 @@
+/**********************************************************************
+ * global alignment with a full DP matrix and traceback               *
+ * align.h                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef ALIGN_H
+#define ALIGN_H
+
+#include "arena.h"
+
+// which optimal alignment is written when there are several. The alignment
+// is walked from the start, and at each step either a diagonal move or a gap
+// is taken first whenever it is on an optimal path.
+typedef enum tiePreference_E {
+  PREFER_DIAGONAL,
+  PREFER_GAP
+} tiePreference;
+
+int globalAlignment(char *, char *, int, int, int, tiePreference, dpArena *, char **);
+
+#endif
@@ -0,0 +1,37 @@
+/**********************************************************************
+ * per-thread scratch memory for DP workspaces and results            *
+ * arena.h                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_MIN_CHUNK (1 << 16) // smallest chunk an arena asks for
+#define ARENA_ALIGN     16        // every allocation starts on this boundary
+
+typedef struct arenaChunk_S {
+  struct arenaChunk_S * next;
+  size_t cap;
+  size_t used;
+  _Alignas(ARENA_ALIGN) char data [];
+} arenaChunk;
+
+// memory owned by one thread and handed out by bumping a pointer. Nothing is
+// freed on its own; a reset gives back everything at once. When a run of
+// allocations overflows into more than one chunk, the reset replaces them
+// with a single chunk as large as the whole run, so after the largest
+// alignment has been seen the arena stops calling the allocator.
+typedef struct dpArena_S {
+  arenaChunk * head; // newest chunk, which allocations come from
+  size_t used;       // bytes handed out since the last reset
+  size_t peak;       // most bytes handed out between two resets
+} dpArena;
+
+void * arenaAlloc(dpArena *, size_t);
+void arenaReset(dpArena *);
+void freeArena(dpArena *);
+
+#endif
@@ -0,0 +1,44 @@
+/**********************************************************************
+ * inputs shared between the commands of a chain                      *
+ * context.h                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stddef.h>
+
+#include "seqio.h"
+
+// the kinds of input a chain keeps
+typedef enum inputKind_E {
+  INPUT_SEQ_SET,  // the records of a FASTA or FASTQ file, as a seqSet
+  INPUT_FM_INDEX  // an fmCollection built from a FASTA file or read from an index
+} inputKind;
+
+typedef struct sharedInput_S {
+  inputKind        kind;
+  char *           path;
+  void *           data;
+  void             (* release)(void *);
+} sharedInput;
+
+// what the commands of one chain have loaded, by kind and path, so a later
+// command with the same input uses it rather than reading it again. Inputs
+// kept here are only read by the commands, and are released with the
+// context. A command run on its own is given NULL, and frees what it loads.
+typedef struct chainContext_S {
+  sharedInput *    inputs;
+  size_t           n;
+  size_t           cap;
+} chainContext;
+
+chainContext * makeChainContext(void);
+void * findInput(chainContext *, inputKind, char *);
+void keepInput(chainContext *, inputKind, char *, void *, void (*)(void *));
+void dropInput(chainContext *, inputKind, char *);
+void freeChainContext(chainContext *);
+seqSet * loadSeqSet(chainContext *, char *);
+
+#endif
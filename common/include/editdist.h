@@ -0,0 +1,39 @@
+/**********************************************************************
+ * bit-parallel edit distance for unit mismatch and indel costs       *
+ * editdist.h                                                         *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef EDITDIST_H
+#define EDITDIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define EDIT_WORD      64        // rows of a column held in one word
+#define EDIT_NO_CUTOFF INT64_MAX
+
+// the edit distance matrix D of str1 against str2 as the differences down
+// each of its columns. In column y, bit x - 1 of pv is set where
+// D[x][y] = D[x - 1][y] + 1 and of mv where D[x][y] = D[x - 1][y] - 1, with
+// nWords words to a column.
+typedef struct editColumns_S {
+  uint64_t *       pv;
+  uint64_t *       mv;
+  size_t           nWords;
+} editColumns;
+
+// whether alignments under these scores are scored as -indel times the
+// number of edits, so the edit distance finds the best of them
+static inline bool unitCosts(int match, int mismatch, int indel) {
+  return match == 0 && mismatch == indel && indel < 0;
+}
+
+int editDistance(char *, size_t, char *, size_t, int64_t, dpArena *, uint64_t *);
+editColumns editMatrix(char *, size_t, char *, size_t, dpArena *);
+int editCell(editColumns *, size_t, size_t);
+
+#endif
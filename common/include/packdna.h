@@ -0,0 +1,47 @@
+/**********************************************************************
+ * nucleotide sequences packed two bits to a base                     *
+ * packdna.h                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef PACKDNA_H
+#define PACKDNA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PACK_BASES 32 // bases in one word
+#define PACK_OTHER 16 // at most one character in this many may be other than A, C, G or T
+
+// a run of one character other than A, C, G or T, such as N. The bases of a
+// run are packed as A, and the run says what they really are.
+typedef struct ambigRun_S {
+  size_t pos;
+  size_t len;
+  char c;
+} ambigRun;
+
+// base i is in bits 2 (i % 32) and up of word i / 32, as A 0, C 1, G 2 and
+// T 3. There is a spare word past the last so 32 bases can be read from any
+// position, and the bits past the last base are 0.
+typedef struct packedSeq_S {
+  uint64_t * words;
+  size_t n;
+  ambigRun * runs;
+  size_t nRuns;
+  size_t nAmbig; // bases in runs
+} packedSeq;
+
+bool worthPacking(char *, size_t);
+packedSeq * packSeq(char *, size_t);
+void freePackedSeq(packedSeq *);
+char packedChar(packedSeq *, size_t);
+void unpackSeq(packedSeq *, size_t, size_t, char *);
+size_t packedMismatches(packedSeq *, size_t, packedSeq *, size_t, size_t);
+size_t packedPrefixMatch(packedSeq *, size_t, packedSeq *, size_t, size_t);
+size_t packedSuffixMatch(packedSeq *, size_t, packedSeq *, size_t, size_t);
+packedSeq * packedRevComp(packedSeq *);
+void reverseComplement(char *, char *, size_t);
+
+#endif
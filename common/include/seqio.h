@@ -0,0 +1,80 @@
+/**********************************************************************
+ * FASTA/FASTQ reader shared by the tools                             *
+ * seqio.h                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef SEQIO_H
+#define SEQIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#define SEQIO_BLOCK   (1 << 16) // bytes read from a gzip stream at a time
+#define SEQIO_RELEASE (1 << 26) // bytes of a streamed map given back at a time
+
+// one record. name is the first word of the header, or "*" for data before
+// any header. qual is NULL for FASTA. All three are NUL-terminated.
+typedef struct seqRecord_S {
+  char * name;
+  char * seq;
+  size_t len;
+  char * qual;
+} seqRecord;
+
+// reads records one at a time. A plain file is mapped and each record is
+// joined in place in a private copy of the map, so nothing is copied that
+// isn't split across lines. A gzip file is read through a bounded buffer and
+// each record is joined into buffers owned by the reader.
+typedef struct seqReader_S {
+  char * path;
+  bool fastq;
+  bool keep;      // leave records in the map valid until the reader is closed
+  bool failed;
+  // a mapped file
+  char * map;
+  size_t mapLen;
+  size_t size;
+  size_t pos;
+  size_t released;
+  // a gzip stream
+  gzFile gz;
+  char * buf;
+  size_t bufLen;
+  size_t bufCap;
+  size_t bufPos;
+  bool eof;
+  char * names[2]; // the record's name and the next header's, swapped in turn
+  size_t nameCap[2];
+  char * seqBuf;
+  size_t seqCap;
+  char * qualBuf;
+  size_t qualCap;
+  // the header read at the end of the previous record
+  bool pending;
+  char * pendingName;
+  char * pendingData; // where its data starts in the map
+} seqReader;
+
+// every record of a file. Records of a plain file point into the reader's
+// map; those of a gzip file are copied into blocks.
+typedef struct seqSet_S {
+  seqRecord * rec;
+  size_t n;
+  size_t cap;
+  seqReader * reader;
+  char ** blocks;
+  size_t nBlocks;
+  size_t blockUsed;
+  size_t blockCap;
+} seqSet;
+
+seqReader * openSeqReader(char *);
+bool nextSeq(seqReader *, seqRecord *);
+void closeSeqReader(seqReader *);
+seqSet * readSeqSet(char *);
+void freeSeqSet(seqSet *);
+
+#endif
@@ -0,0 +1,54 @@
+/**********************************************************************
+ * per-phase timings and counters reported with --stats               *
+ * stats.h                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the phases a run is timed in. Each tool uses the ones it has. Phases run
+// inside worker threads are summed over the threads, so they can add up to
+// more than the wall time of the phase around them.
+typedef enum statPhase_E {
+  PHASE_LOAD,      // reading the input
+  PHASE_PACK,      // packing sequences two bits to a base
+  PHASE_SA,        // suffix array construction
+  PHASE_BWT,       // BW string
+  PHASE_OCC,       // C and occurrence tables
+  PHASE_LCP,       // LCP array
+  PHASE_SEARCH,    // pattern search, or seeding and chaining reads
+  PHASE_WRITE,     // writing an index file
+  PHASE_CENTER,    // picking the center string
+  PHASE_DP_FILL,   // filling DP matrices
+  PHASE_TRACEBACK, // tracing alignments back through them
+  PHASE_MERGE,     // merging pairwise alignments into the MSA
+  N_PHASES
+} statPhase;
+
+typedef enum statCounter_E {
+  COUNT_DP_CELLS,       // DP cells computed
+  COUNT_BACKWARD_STEPS, // FM-index backward search steps
+  COUNT_QUERIES,        // patterns searched or reads mapped
+  COUNT_TEXT_CHARS,     // characters of text scanned
+  COUNT_DP_WORDS,       // words of bit-parallel DP columns computed
+  N_COUNTERS
+} statCounter;
+
+// off unless --stats was given. Every call below is a single branch while it
+// is off, and hot loops count into a local and add it once when they finish.
+extern bool statsOn;
+extern uint64_t statCounts [N_COUNTERS];
+
+int statsOption(int, char **);
+uint64_t statsStart(void);
+void statsStop(statPhase, uint64_t);
+
+static inline void statsAdd(statCounter c, uint64_t v) {
+  if (statsOn) __atomic_fetch_add(&statCounts[c], v, __ATOMIC_RELAXED);
+}
+
+#endif
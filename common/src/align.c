@@ -0,0 +1,275 @@
+/**********************************************************************
+ * global alignment with a full DP matrix and traceback               *
+ * align.c                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "align.h"
+#include "editdist.h"
+#include "stats.h"
+
+#define SEEN    0x8
+#define LEFT    0x4
+#define UPLEFT  0x2
+#define UP      0x1
+
+// whether the step out of (x, y) is on an optimal path
+typedef bool (* stepFn)(void *, char, uint32_t, uint32_t);
+
+// the directions tabulated over the full matrix
+typedef struct fullPaths_S {
+  char *           V_b;
+  size_t           width;
+} fullPaths;
+
+// the edit distance matrix of the strings, and of the strings reversed
+typedef struct unitPaths_S {
+  char *           str1;
+  size_t           nStr1;
+  char *           str2;
+  size_t           nStr2;
+  editColumns      fwd;
+  editColumns      bwd;
+  int              total;
+} unitPaths;
+
+/**
+ * Helper functions
+ */
+
+static bool onFullPath(void * ctx, char step, uint32_t x, uint32_t y) {
+  fullPaths * p = ctx;
+  uint32_t nx = x + (step != LEFT);
+  uint32_t ny = y + (step != UP);
+  return p->V_b[nx * p->width + ny] & step;
+}
+
+// a step is on an optimal path if it costs what D says it does, and the best
+// alignment of what is left of the strings after it makes up the rest
+static bool onUnitPath(void * ctx, char step, uint32_t x, uint32_t y) {
+  unitPaths * p = ctx;
+  uint32_t nx = x + (step != LEFT);
+  uint32_t ny = y + (step != UP);
+  int cost = step == UPLEFT ? p->str1[x] != p->str2[y] : 1;
+  int d = editCell(&p->fwd, nx, ny);
+  return d == editCell(&p->fwd, x, y) + cost &&
+    d + editCell(&p->bwd, p->nStr1 - nx, p->nStr2 - ny) == p->total;
+}
+
+// walks an optimal path from the start, taking the first move on one at
+// each step, and writes the gapped strings on two lines. Sa has room for Ta
+// to be joined on after it.
+static char * writeAlignment(
+  char *           str1,
+  size_t           nStr1,
+  char *           str2,
+  size_t           nStr2,
+  tiePreference    prefer,
+  stepFn           onPath,
+  void *           ctx,
+  dpArena *        arena)
+
+{
+  char * Sa = arenaAlloc(arena, 2 * (nStr1 + nStr2) + 2);
+  char * Ta = arenaAlloc(arena, nStr1 + nStr2 + 1);
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t i = 0;
+  while (x < nStr1 || y < nStr2) {
+    if (x == nStr1) {
+      Sa[i] = '_';
+      Ta[i] = str2[y];
+      y++;
+    } else if (y == nStr2) {
+      Sa[i] = str1[x];
+      Ta[i] = '_';
+      x++;
+    } else {
+      // the first move on an optimal path out of (x, y)
+      char step = UPLEFT;
+      if (prefer == PREFER_DIAGONAL && onPath(ctx, UPLEFT, x, y)) step = UPLEFT;
+      else if (onPath(ctx, LEFT, x, y)) step = LEFT;
+      else if (onPath(ctx, UP, x, y)) step = UP;
+      Sa[i] = step == LEFT ? '_' : str1[x];
+      Ta[i] = step == UP ? '_' : str2[y];
+      if (step != LEFT) x++;
+      if (step != UP) y++;
+    }
+    i++;
+  }
+  Sa[i] = '\n';
+  memcpy(Sa + i + 1, Ta, i);
+  Sa[2 * i + 1] = 0;
+  return Sa;
+}
+
+// the alignment under unit costs, scaled by -indel. Only the differences
+// down each column of the edit distance matrix are kept, both ways, which
+// is all the walk needs to tell whether a cell is on an optimal path.
+static int unitAlignment(
+  char *           str1,
+  size_t           nStr1,
+  char *           str2,
+  size_t           nStr2,
+  int              indel,
+  tiePreference    prefer,
+  dpArena *        arena,
+  char **          pRetStr)
+
+{
+  uint64_t t0 = statsStart();
+  if (pRetStr == NULL) {
+    int d = editDistance(str1, nStr1, str2, nStr2, EDIT_NO_CUTOFF, arena, NULL);
+    statsStop(PHASE_DP_FILL, t0);
+    return d * indel;
+  }
+  char * rev1 = arenaAlloc(arena, nStr1 + nStr2);
+  char * rev2 = rev1 + nStr1;
+  for (size_t x = 0; x < nStr1; x++) rev1[x] = str1[nStr1 - 1 - x];
+  for (size_t y = 0; y < nStr2; y++) rev2[y] = str2[nStr2 - 1 - y];
+  unitPaths paths = { .str1 = str1, .nStr1 = nStr1, .str2 = str2, .nStr2 = nStr2 };
+  paths.fwd = editMatrix(str1, nStr1, str2, nStr2, arena);
+  paths.bwd = editMatrix(rev1, nStr1, rev2, nStr2, arena);
+  paths.total = editCell(&paths.fwd, nStr1, nStr2);
+  statsStop(PHASE_DP_FILL, t0);
+
+  t0 = statsStart();
+  * pRetStr = writeAlignment(str1, nStr1, str2, nStr2, prefer, onUnitPath, &paths, arena);
+  statsStop(PHASE_TRACEBACK, t0);
+  return paths.total * indel;
+}
+
+
+/**
+ * primary calls
+ */
+
+// The global alignment of str1 and str2 under the given scores, which is
+// maximized. Returns the score, and if pRetStr is set writes the gapped
+// strings to it on two lines, with _ for a gap. prefer picks between equally
+// good alignments. Under unit costs the bit-parallel edit distance stands
+// in for the matrices. The matrices and the alignment are taken from the
+// arena, so the alignment is only valid until the arena is reset.
+int globalAlignment(
+  char *           str1, 
+  char *           str2, 
+  int              match, 
+  int              mismatch, 
+  int              indel, 
+  tiePreference    prefer,
+  dpArena *        arena,
+  char **          pRetStr)
+
+{
+  // get the number of characters in S and T
+  size_t nStr1 = strlen(str1);
+  size_t nStr2 = strlen(str2);
+  if (unitCosts(match, mismatch, indel)) {
+    return unitAlignment(str1, nStr1, str2, nStr2, indel, prefer, arena, pRetStr);
+  }
+
+  // create the V matrix
+  uint64_t t0 = statsStart();
+  int (* V)[nStr2 + 1] = arenaAlloc(arena, sizeof(int) * (nStr1 + 1) * (nStr2 + 1));
+  for (size_t x = 0; x < nStr1 + 1; x++) {
+    for (size_t y = 0; y < nStr2 + 1; y++) {
+      if (x == 0 && y == 0) {
+        V[x][y] = 0;
+      } else if (x == 0) {
+        V[x][y] = V[x][y - 1] + indel;
+      } else if (y == 0) {
+        V[x][y] = V[x - 1][y] + indel;
+      } else {
+        int u = V[x - 1][y] + indel;
+        int l = V[x][y - 1] + indel;
+        int ul = V[x - 1][y - 1] + (str1[x - 1] == str2[y - 1] ? match : mismatch);
+        V[x][y] = (u > l ? (u > ul ? u : ul) : (l > ul ? l : ul));
+      }
+    }
+  }
+  statsStop(PHASE_DP_FILL, t0);
+  statsAdd(COUNT_DP_CELLS, (uint64_t) (nStr1 + 1) * (nStr2 + 1));
+  // If there isn't a string to print to, return the score here
+  if (pRetStr == NULL) return V[nStr1][nStr2];
+
+#ifdef DEBUG
+  // Print out the V matrix for debugging
+  fprintf(stdout, " % 4c", '_');
+  for (int y = 0; y < nStr2 + 1; y++) 
+    fprintf(stdout, "% 4c", str2[y]);
+  fprintf(stdout, "\n");
+  for (int x = 0; x < nStr1 + 1; x++) {
+    if (x == 0) fprintf(stdout, "_");
+    else fprintf(stdout, "%c", str1[x - 1]);
+    for (int y = 0; y < nStr2 + 1; y++) {
+      fprintf(stdout, "% 4d", V[x][y]);
+    }
+    fprintf(stdout, "\n");
+  }
+#endif
+  
+  //tabulate all paths
+  t0 = statsStart();
+  char (* V_b)[nStr2 + 1] = arenaAlloc(arena, (nStr1 + 1) * (nStr2 + 1));
+  memset(V_b, 0, (nStr1 + 1) * (nStr2 + 1));
+  V_b[nStr1][nStr2] = SEEN;
+  for (int x = nStr1; x >= 0; x--) {
+    for (int y = nStr2; y >= 0; y--) {
+      if (!(V_b[x][y] & SEEN)) continue;
+      if (x == 0 && y == 0) break;
+      if (x == 0) {
+        V_b[x][y] = LEFT;
+        V_b[x][y - 1] = SEEN;
+      } else if (y == 0) {
+        V_b[x][y] = UP;
+        V_b[x - 1][y] = SEEN;
+      } else {
+        if (
+          (V[x - 1][y - 1] + match == V[x][y] && str1[x - 1] == str2[y - 1]) ||
+          (V[x - 1][y - 1] + mismatch == V[x][y] && str1[x - 1] != str2[y - 1])
+        ) {
+          V_b[x][y] = UPLEFT;
+          V_b[x - 1][y - 1] = SEEN;
+        }
+        if (V[x][y - 1] + indel == V[x][y]) {
+          V_b[x][y] += LEFT;
+          V_b[x][y - 1] = SEEN;
+        }
+        if (V[x - 1][y] + indel == V[x][y]) {
+          V_b[x][y] += UP;
+          V_b[x - 1][y] = SEEN;
+        }
+      }
+    }
+  }
+
+
+#ifdef DEBUG
+  for (int x = 0; x < nStr1 + 1; x++) {
+    for (int y = 0; y < nStr2 + 1; y++) {
+      if (x == 0 && y == 0) fprintf(stdout, "% 4c", '*');
+      else {
+        char directions[4] = {
+          V_b[x][y] & LEFT      ? 'L' : '-',
+          V_b[x][y] & UPLEFT    ? 'D' : '-',
+          V_b[x][y] & UP        ? 'U' : '-',
+          0
+        };
+        fprintf(stdout, "% 4s", directions);
+      }
+    }
+    fprintf(stdout, "\n");
+  }
+#endif
+
+  fullPaths paths = { (char *) V_b, nStr2 + 1 };
+  * pRetStr = writeAlignment(str1, nStr1, str2, nStr2, prefer, onFullPath, &paths, arena);
+  statsStop(PHASE_TRACEBACK, t0);
+
+  return V[nStr1][nStr2];
+}
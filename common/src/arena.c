@@ -0,0 +1,68 @@
+/**********************************************************************
+ * per-thread scratch memory for DP workspaces and results            *
+ * arena.c                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+/**
+ * Helper functions
+ */
+
+static arenaChunk * newChunk(size_t cap, arenaChunk * next) {
+  arenaChunk * c = malloc(sizeof(arenaChunk) + cap);
+  c->next = next;
+  c->cap = cap;
+  c->used = 0;
+  return c;
+}
+
+static void freeChunks(arenaChunk * c) {
+  while (c) {
+    arenaChunk * next = c->next;
+    free(c);
+    c = next;
+  }
+}
+
+
+/**
+ * primary calls
+ */
+
+// n bytes that stay valid until the next reset
+void * arenaAlloc(dpArena * a, size_t n) {
+  n = (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  if (a->head == NULL || a->head->cap - a->head->used < n) {
+    size_t cap = a->head ? 2 * a->head->cap : ARENA_MIN_CHUNK;
+    if (cap < n) cap = n;
+    a->head = newChunk(cap, a->head);
+  }
+  void * p = a->head->data + a->head->used;
+  a->head->used += n;
+  a->used += n;
+  if (a->used > a->peak) a->peak = a->used;
+  return p;
+}
+
+void arenaReset(dpArena * a) {
+  if (a->head && a->head->next) {
+    freeChunks(a->head);
+    a->head = newChunk(a->peak, NULL);
+  } else if (a->head) {
+    a->head->used = 0;
+  }
+  a->used = 0;
+}
+
+void freeArena(dpArena * a) {
+  freeChunks(a->head);
+  a->head = NULL;
+  a->used = 0;
+  a->peak = 0;
+}
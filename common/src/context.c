@@ -0,0 +1,101 @@
+/**********************************************************************
+ * inputs shared between the commands of a chain                      *
+ * context.c                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "context.h"
+
+/**
+ * Helper functions
+ */
+
+// the same data can be kept under more than one path, and is released with
+// the last of them
+static bool heldElsewhere(chainContext * ctx, size_t k) {
+  for (size_t i = 0; i < ctx->n; i++) {
+    if (i != k && ctx->inputs[i].data == ctx->inputs[k].data) return true;
+  }
+  return false;
+}
+
+static void removeInput(chainContext * ctx, size_t k) {
+  if (!heldElsewhere(ctx, k)) ctx->inputs[k].release(ctx->inputs[k].data);
+  free(ctx->inputs[k].path);
+  ctx->inputs[k] = ctx->inputs[--ctx->n];
+}
+
+static void releaseSeqSet(void * set) {
+  freeSeqSet(set);
+}
+
+
+/**
+ * primary calls
+ */
+
+chainContext * makeChainContext(void) {
+  chainContext * ctx = malloc(sizeof(chainContext));
+  ctx->n = 0;
+  ctx->cap = 8;
+  ctx->inputs = malloc(sizeof(sharedInput) * ctx->cap);
+  return ctx;
+}
+
+// the input of this kind kept for path, or NULL
+void * findInput(chainContext * ctx, inputKind kind, char * path) {
+  if (ctx == NULL) return NULL;
+  for (size_t i = 0; i < ctx->n; i++) {
+    if (ctx->inputs[i].kind == kind && strcmp(ctx->inputs[i].path, path) == 0) {
+      return ctx->inputs[i].data;
+    }
+  }
+  return NULL;
+}
+
+// keeps data for path, replacing what was kept for it before. The context
+// takes ownership of data, and frees it with release.
+void keepInput(chainContext * ctx, inputKind kind, char * path, void * data, void (* release)(void *)) {
+  dropInput(ctx, kind, path);
+  if (ctx->n == ctx->cap) {
+    ctx->cap *= 2;
+    ctx->inputs = realloc(ctx->inputs, sizeof(sharedInput) * ctx->cap);
+  }
+  ctx->inputs[ctx->n++] = (sharedInput) { kind, strdup(path), data, release };
+}
+
+// forgets the input kept for path, as when the file at path has changed
+void dropInput(chainContext * ctx, inputKind kind, char * path) {
+  if (ctx == NULL) return;
+  for (size_t i = 0; i < ctx->n; i++) {
+    if (ctx->inputs[i].kind == kind && strcmp(ctx->inputs[i].path, path) == 0) {
+      removeInput(ctx, i);
+      return;
+    }
+  }
+}
+
+void freeChainContext(chainContext * ctx) {
+  if (ctx == NULL) return;
+  while (ctx->n > 0) {
+    removeInput(ctx, ctx->n - 1);
+  }
+  free(ctx->inputs);
+  free(ctx);
+}
+
+// the records of the file at path, read now or kept from an earlier command.
+// Without a context the caller frees the set.
+seqSet * loadSeqSet(chainContext * ctx, char * path) {
+  seqSet * set = findInput(ctx, INPUT_SEQ_SET, path);
+  if (set) return set;
+  set = readSeqSet(path);
+  if (set && ctx) keepInput(ctx, INPUT_SEQ_SET, path, set, releaseSeqSet);
+  return set;
+}
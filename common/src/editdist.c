@@ -0,0 +1,172 @@
+/**********************************************************************
+ * bit-parallel edit distance for unit mismatch and indel costs       *
+ * editdist.c                                                         *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editdist.h"
+#include "stats.h"
+
+/**
+ * Helper functions
+ */
+
+// the match masks of the n characters of str, one row of w words for each
+// character in it. Bit x % 64 of word x / 64 of the row of str[x] is set,
+// and code gives each character its row. Characters not in str get row 0,
+// which is all zero.
+static uint64_t * matchMasks(char * str, size_t n, size_t w, uint16_t * code, dpArena * arena) {
+  memset(code, 0, sizeof(uint16_t) * 256);
+  size_t nCodes = 1;
+  for (size_t x = 0; x < n; x++) {
+    unsigned char c = str[x];
+    if (code[c] == 0) code[c] = nCodes++;
+  }
+  uint64_t * eq = arenaAlloc(arena, sizeof(uint64_t) * nCodes * w);
+  memset(eq, 0, sizeof(uint64_t) * nCodes * w);
+  for (size_t x = 0; x < n; x++) {
+    eq[code[(unsigned char) str[x]] * w + x / EDIT_WORD] |= 1ULL << (x % EDIT_WORD);
+  }
+  return eq;
+}
+
+// moves the w words of pv and mv on by one column, whose character has the
+// match masks eq, and returns how much D changed in the last row. last is the
+// bit of the last row in the last word. Each word takes the change along the
+// row above it from the word before, and the top row gains 1 a column.
+// (Myers 1999, with Hyyrö's blocks)
+static inline int advanceColumn(uint64_t * pv, uint64_t * mv, uint64_t * eq, size_t w, uint64_t last) {
+  int hin = 1;
+  for (size_t b = 0; b < w; b++) {
+    uint64_t high = b + 1 < w ? 1ULL << (EDIT_WORD - 1) : last;
+    uint64_t hinNeg = hin < 0;
+    uint64_t Pv = pv[b];
+    uint64_t Mv = mv[b];
+    uint64_t Eq = eq[b];
+    uint64_t Xv = Eq | Mv;
+    Eq |= hinNeg;
+    uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+    uint64_t Ph = Mv | ~(Xh | Pv);
+    uint64_t Mh = Pv & Xh;
+    int hout = (Ph & high ? 1 : 0) - (Mh & high ? 1 : 0);
+    Ph = (Ph << 1) | (hin > 0);
+    Mh = (Mh << 1) | hinNeg;
+    pv[b] = Mh | ~(Xv | Ph);
+    mv[b] = Ph & Xv;
+    hin = hout;
+  }
+  return hin;
+}
+
+
+/**
+ * primary calls
+ */
+
+// the edit distance of the first nStr1 characters of str1 and the first
+// nStr2 of str2, if it is at most cutoff. Otherwise some value over cutoff is
+// returned as soon as that is certain. The shorter string runs down the
+// columns, so a column takes one word for every 64 of its characters. The
+// number of cells covered is added to pCells if it is set.
+int editDistance(
+  char *           str1,
+  size_t           nStr1,
+  char *           str2,
+  size_t           nStr2,
+  int64_t          cutoff,
+  dpArena *        arena,
+  uint64_t *       pCells)
+
+{
+  if (nStr1 > nStr2) {
+    char * s = str1;
+    size_t n = nStr1;
+    str1 = str2;
+    nStr1 = nStr2;
+    str2 = s;
+    nStr2 = n;
+  }
+  if ((int64_t) (nStr2 - nStr1) > cutoff) return cutoff + 1;
+  if (nStr1 == 0) return nStr2;
+
+  size_t w = (nStr1 + EDIT_WORD - 1) / EDIT_WORD;
+  uint16_t code [256];
+  uint64_t * eq = matchMasks(str1, nStr1, w, code, arena);
+  uint64_t * pv = arenaAlloc(arena, sizeof(uint64_t) * w);
+  uint64_t * mv = arenaAlloc(arena, sizeof(uint64_t) * w);
+  for (size_t b = 0; b < w; b++) {
+    pv[b] = ~0ULL;
+    mv[b] = 0;
+  }
+  uint64_t last = 1ULL << ((nStr1 - 1) % EDIT_WORD);
+
+  int64_t d = nStr1;
+  size_t y = 0;
+  while (y < nStr2) {
+    d += advanceColumn(pv, mv, eq + code[(unsigned char) str2[y]] * w, w, last);
+    y++;
+    // the last row changes by at most 1 a column, so this bounds the distance
+    if (d - (int64_t) (nStr2 - y) > cutoff) break;
+  }
+  statsAdd(COUNT_DP_WORDS, (uint64_t) w * y);
+  if (pCells) *pCells += (uint64_t) (nStr1 + 1) * (y + 1);
+  return d > cutoff ? cutoff + 1 : d;
+}
+
+// every column of the edit distance matrix of the first nStr1 characters of
+// str1, down the rows, and the first nStr2 of str2, across the columns. The
+// columns are taken from the arena.
+editColumns editMatrix(
+  char *           str1,
+  size_t           nStr1,
+  char *           str2,
+  size_t           nStr2,
+  dpArena *        arena)
+
+{
+  size_t w = (nStr1 + EDIT_WORD - 1) / EDIT_WORD;
+  editColumns m = {
+    arenaAlloc(arena, sizeof(uint64_t) * w * (nStr2 + 1)),
+    arenaAlloc(arena, sizeof(uint64_t) * w * (nStr2 + 1)),
+    w
+  };
+  if (w == 0) return m;
+
+  uint16_t code [256];
+  uint64_t * eq = matchMasks(str1, nStr1, w, code, arena);
+  uint64_t last = 1ULL << ((nStr1 - 1) % EDIT_WORD);
+  for (size_t b = 0; b < w; b++) {
+    m.pv[b] = ~0ULL;
+    m.mv[b] = 0;
+  }
+  for (size_t y = 1; y <= nStr2; y++) {
+    uint64_t * pv = m.pv + y * w;
+    uint64_t * mv = m.mv + y * w;
+    memcpy(pv, pv - w, sizeof(uint64_t) * w);
+    memcpy(mv, mv - w, sizeof(uint64_t) * w);
+    advanceColumn(pv, mv, eq + code[(unsigned char) str2[y - 1]] * w, w, last);
+  }
+  statsAdd(COUNT_DP_WORDS, (uint64_t) w * nStr2);
+  return m;
+}
+
+// D[x][y], counted down column y from D[0][y] = y
+int editCell(editColumns * m, size_t x, size_t y) {
+  uint64_t * pv = m->pv + y * m->nWords;
+  uint64_t * mv = m->mv + y * m->nWords;
+  int d = y;
+  size_t b = 0;
+  for (; b < x / EDIT_WORD; b++) {
+    d += __builtin_popcountll(pv[b]) - __builtin_popcountll(mv[b]);
+  }
+  if (x % EDIT_WORD) {
+    uint64_t mask = (1ULL << (x % EDIT_WORD)) - 1;
+    d += __builtin_popcountll(pv[b] & mask) - __builtin_popcountll(mv[b] & mask);
+  }
+  return d;
+}
@@ -0,0 +1,291 @@
+/**********************************************************************
+ * nucleotide sequences packed two bits to a base                     *
+ * packdna.c                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packdna.h"
+
+#define LOW_BITS 0x5555555555555555ULL // the low bit of every base
+
+static const char BASES [4] = { 'A', 'C', 'G', 'T' };
+
+/**
+ * Helper functions
+ */
+
+static int baseCode(char c) {
+  switch (c) {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    default:  return -1;
+  }
+}
+
+// the complement of a base or IUPAC ambiguity code, keeping its case
+static char complement(char c) {
+  static const char from [] = "ACGTRYKMBVDHSWNacgtrykmbvdhswn";
+  static const char to [] =   "TGCAYRMKVBHDSWNtgcayrmkvbhdswn";
+  char * p = strchr(from, c);
+  return p && c ? to[p - from] : c;
+}
+
+// writes the reverse complement of the n characters of src to dst, and a
+// NUL after them
+void reverseComplement(char * dst, char * src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = complement(src[n - 1 - i]);
+  }
+  dst[n] = 0;
+}
+
+// the 32 bases starting at base i
+static inline uint64_t basesAt(packedSeq * p, size_t i) {
+  size_t w = i / PACK_BASES;
+  unsigned s = 2 * (i % PACK_BASES);
+  uint64_t x = p->words[w] >> s;
+  if (s) x |= p->words[w + 1] << (64 - s);
+  return x;
+}
+
+// one bit at the low bit of every base of x that is not 0, over the first
+// len bases
+static inline uint64_t nonZeroBases(uint64_t x, size_t len) {
+  uint64_t m = (x | (x >> 1)) & LOW_BITS;
+  if (len < PACK_BASES) m &= (1ULL << (2 * len)) - 1;
+  return m;
+}
+
+// reverses the order of the 32 bases of a word
+static inline uint64_t reverseBases(uint64_t x) {
+  x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+  x = ((x >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((x & 0x0f0f0f0f0f0f0f0fULL) << 4);
+  return __builtin_bswap64(x);
+}
+
+// the first run that ends after position i
+static size_t firstRun(packedSeq * p, size_t i) {
+  size_t lo = 0;
+  size_t hi = p->nRuns;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (p->runs[mid].pos + p->runs[mid].len <= i) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// the first position of [ia, ia + len) in a run of a where a and b really
+// differ, as an offset, or len if there is none
+static size_t firstRunMismatch(packedSeq * a, size_t ia, packedSeq * b, size_t ib, size_t len) {
+  for (size_t r = firstRun(a, ia); r < a->nRuns && a->runs[r].pos < ia + len; r++) {
+    size_t from = a->runs[r].pos > ia ? a->runs[r].pos : ia;
+    size_t to = a->runs[r].pos + a->runs[r].len;
+    if (to > ia + len) to = ia + len;
+    for (size_t q = from; q < to; q++) {
+      if (packedChar(b, ib + q - ia) != a->runs[r].c) return q - ia;
+    }
+  }
+  return len;
+}
+
+// the last position of [ia, ia + len) in a run of a where a and b really
+// differ, as an offset, or len if there is none
+static size_t lastRunMismatch(packedSeq * a, size_t ia, packedSeq * b, size_t ib, size_t len) {
+  size_t r = firstRun(a, ia + len);
+  if (r == a->nRuns || a->runs[r].pos >= ia + len) {
+    if (r == 0) return len;
+    r--;
+  }
+  for (;; r--) {
+    if (a->runs[r].pos + a->runs[r].len <= ia) return len;
+    size_t from = a->runs[r].pos > ia ? a->runs[r].pos : ia;
+    size_t to = a->runs[r].pos + a->runs[r].len;
+    if (to > ia + len) to = ia + len;
+    for (size_t q = to; q > from; q--) {
+      if (packedChar(b, ib + q - 1 - ia) != a->runs[r].c) return q - 1 - ia;
+    }
+    if (r == 0) return len;
+  }
+}
+
+
+/**
+ * primary calls
+ */
+
+// true if at most one of the n characters of s in PACK_OTHER is something
+// other than A, C, G or T. Past that the runs cost more than packing saves.
+bool worthPacking(char * s, size_t n) {
+  size_t other = 0;
+  for (size_t i = 0; i < n; i++) {
+    other += baseCode(s[i]) < 0;
+  }
+  return other <= n / PACK_OTHER;
+}
+
+// packs n characters. Anything but A, C, G and T is kept as a run.
+packedSeq * packSeq(char * s, size_t n) {
+  packedSeq * p = malloc(sizeof(packedSeq));
+  p->n = n;
+  p->words = calloc(n / PACK_BASES + 2, sizeof(uint64_t));
+  p->runs = NULL;
+  p->nRuns = 0;
+  p->nAmbig = 0;
+  size_t cap = 0;
+  for (size_t i = 0; i < n; i++) {
+    int code = baseCode(s[i]);
+    if (code >= 0) {
+      p->words[i / PACK_BASES] |= (uint64_t) code << (2 * (i % PACK_BASES));
+      continue;
+    }
+    p->nAmbig++;
+    ambigRun * last = p->nRuns ? &p->runs[p->nRuns - 1] : NULL;
+    if (last && last->c == s[i] && last->pos + last->len == i) {
+      last->len++;
+      continue;
+    }
+    if (p->nRuns == cap) {
+      cap = cap ? 2 * cap : 16;
+      p->runs = realloc(p->runs, sizeof(ambigRun) * cap);
+    }
+    p->runs[p->nRuns++] = (ambigRun) { i, 1, s[i] };
+  }
+  return p;
+}
+
+void freePackedSeq(packedSeq * p) {
+  if (!p) return;
+  free(p->words);
+  free(p->runs);
+  free(p);
+}
+
+// the character at position i
+char packedChar(packedSeq * p, size_t i) {
+  size_t r = firstRun(p, i);
+  if (r < p->nRuns && p->runs[r].pos <= i) return p->runs[r].c;
+  return BASES[(p->words[i / PACK_BASES] >> (2 * (i % PACK_BASES))) & 3];
+}
+
+// writes the len characters from position i to out, without a terminator
+void unpackSeq(packedSeq * p, size_t i, size_t len, char * out) {
+  for (size_t k = 0; k < len; k++) {
+    out[k] = BASES[(p->words[(i + k) / PACK_BASES] >> (2 * ((i + k) % PACK_BASES))) & 3];
+  }
+  for (size_t r = firstRun(p, i); r < p->nRuns && p->runs[r].pos < i + len; r++) {
+    size_t from = p->runs[r].pos > i ? p->runs[r].pos : i;
+    size_t to = p->runs[r].pos + p->runs[r].len;
+    if (to > i + len) to = i + len;
+    memset(out + from - i, p->runs[r].c, to - from);
+  }
+}
+
+// the number of positions where a[ia, ia + len) and b[ib, ib + len) differ.
+// The codes are compared 32 bases to a word. Codes that differ are always
+// different characters, so only positions in runs, which are packed as A, need
+// to be looked at one at a time.
+size_t packedMismatches(packedSeq * a, size_t ia, packedSeq * b, size_t ib, size_t len) {
+  size_t count = 0;
+  for (size_t k = 0; k < len; k += PACK_BASES) {
+    count += __builtin_popcountll(nonZeroBases(basesAt(a, ia + k) ^ basesAt(b, ib + k), len - k));
+  }
+
+  // a run against a base only matched when the base is A, and a run against a
+  // run matched whatever the characters were
+  for (size_t r = firstRun(a, ia); r < a->nRuns && a->runs[r].pos < ia + len; r++) {
+    size_t from = a->runs[r].pos > ia ? a->runs[r].pos : ia;
+    size_t to = a->runs[r].pos + a->runs[r].len;
+    if (to > ia + len) to = ia + len;
+    for (size_t q = from; q < to; q++) {
+      char c = packedChar(b, ib + q - ia);
+      count += c != a->runs[r].c && (c == 'A' || baseCode(c) < 0);
+    }
+  }
+  for (size_t r = firstRun(b, ib); r < b->nRuns && b->runs[r].pos < ib + len; r++) {
+    size_t from = b->runs[r].pos > ib ? b->runs[r].pos : ib;
+    size_t to = b->runs[r].pos + b->runs[r].len;
+    if (to > ib + len) to = ib + len;
+    for (size_t q = from; q < to; q++) {
+      count += packedChar(a, ia + q - ib) == 'A';
+    }
+  }
+  return count;
+}
+
+// the length of the longest common prefix of a[ia, ..) and b[ib, ..), up to
+// max bases
+size_t packedPrefixMatch(packedSeq * a, size_t ia, packedSeq * b, size_t ib, size_t max) {
+  size_t l = max;
+  for (size_t k = 0; k < max; k += PACK_BASES) {
+    uint64_t m = nonZeroBases(basesAt(a, ia + k) ^ basesAt(b, ib + k), max - k);
+    if (m) {
+      l = k + __builtin_ctzll(m) / 2;
+      break;
+    }
+  }
+  if (a->nRuns) l = firstRunMismatch(a, ia, b, ib, l);
+  if (b->nRuns) l = firstRunMismatch(b, ib, a, ia, l);
+  return l;
+}
+
+// the length of the longest common suffix of a[.., ea) and b[.., eb), up to
+// max bases
+size_t packedSuffixMatch(packedSeq * a, size_t ea, packedSeq * b, size_t eb, size_t max) {
+  size_t l = max;
+  for (size_t k = 0; k < max; k += PACK_BASES) {
+    size_t w = max - k < PACK_BASES ? max - k : PACK_BASES;
+    uint64_t m = nonZeroBases(basesAt(a, ea - k - w) ^ basesAt(b, eb - k - w), w);
+    if (m) {
+      l = k + w - 1 - (63 - __builtin_clzll(m)) / 2;
+      break;
+    }
+  }
+  if (a->nRuns) {
+    size_t q = lastRunMismatch(a, ea - l, b, eb - l, l);
+    if (q < l) l = l - 1 - q;
+  }
+  if (b->nRuns) {
+    size_t q = lastRunMismatch(b, eb - l, a, ea - l, l);
+    if (q < l) l = l - 1 - q;
+  }
+  return l;
+}
+
+// the reverse complement. Each word is built from the 32 bases that end where
+// the previous one started, reversed a word at a time and complemented.
+packedSeq * packedRevComp(packedSeq * p) {
+  size_t n = p->n;
+  packedSeq * r = malloc(sizeof(packedSeq));
+  r->n = n;
+  r->words = calloc(n / PACK_BASES + 2, sizeof(uint64_t));
+  for (size_t w = 0; w * PACK_BASES < n; w++) {
+    size_t end = n - w * PACK_BASES;
+    size_t cnt = end < PACK_BASES ? end : PACK_BASES;
+    uint64_t x = reverseBases(basesAt(p, end - cnt)) >> (2 * (PACK_BASES - cnt));
+    x = ~x;
+    if (cnt < PACK_BASES) x &= (1ULL << (2 * cnt)) - 1;
+    r->words[w] = x;
+  }
+
+  // runs come out in the reverse order, and go back to being packed as A
+  r->nRuns = p->nRuns;
+  r->nAmbig = p->nAmbig;
+  r->runs = malloc(sizeof(ambigRun) * (p->nRuns ? p->nRuns : 1));
+  for (size_t k = 0; k < p->nRuns; k++) {
+    ambigRun * run = &p->runs[p->nRuns - 1 - k];
+    size_t pos = n - run->pos - run->len;
+    r->runs[k] = (ambigRun) { pos, run->len, complement(run->c) };
+    for (size_t q = pos; q < pos + run->len; q++) {
+      r->words[q / PACK_BASES] &= ~(3ULL << (2 * (q % PACK_BASES)));
+    }
+  }
+  return r;
+}
@@ -0,0 +1,354 @@
+/**********************************************************************
+ * FASTA/FASTQ reader shared by the tools                             *
+ * seqio.c                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "seqio.h"
+
+/**
+ * Helper functions
+ */
+
+// grows a buffer to hold at least need bytes
+static char * reserve(char * buf, size_t * pCap, size_t need) {
+  if (need <= *pCap) return buf;
+  size_t cap = *pCap ? *pCap : 256;
+  while (cap < need) cap *= 2;
+  *pCap = cap;
+  return realloc(buf, cap);
+}
+
+// the next line without its line ending, or false at the end of the input.
+// A mapped line stays in the map; a streamed line is only valid until the
+// next call.
+static bool nextLine(seqReader * r, char ** pLine, size_t * pLen) {
+  char * line;
+  size_t len;
+  if (r->map) {
+    if (r->pos >= r->size) return false;
+    line = r->map + r->pos;
+    char * end = memchr(line, '\n', r->size - r->pos);
+    len = end ? (size_t) (end - line) : r->size - r->pos;
+    r->pos += len + (end != NULL);
+  } else {
+    for (;;) {
+      line = r->buf + r->bufPos;
+      size_t avail = r->bufLen - r->bufPos;
+      char * end = memchr(line, '\n', avail);
+      if (end || r->eof) {
+        if (!end && avail == 0) return false;
+        len = end ? (size_t) (end - line) : avail;
+        r->bufPos += len + (end != NULL);
+        break;
+      }
+      // keep the partial line and read another block after it. The buffer
+      // only grows past one block for a line longer than that.
+      memmove(r->buf, line, avail);
+      r->bufPos = 0;
+      r->bufLen = avail;
+      r->buf = reserve(r->buf, &r->bufCap, r->bufLen + SEQIO_BLOCK);
+      int got = gzread(r->gz, r->buf + r->bufLen, SEQIO_BLOCK);
+      if (got < 0) {
+        fprintf(stderr, "error reading file at %s\n", r->path);
+        r->failed = true;
+        return false;
+      }
+      if (got == 0) r->eof = true;
+      r->bufLen += got;
+    }
+  }
+  while (len > 0 && line[len - 1] == '\r') len--;
+  *pLine = line;
+  *pLen = len;
+  return true;
+}
+
+// the first word of a header line. In the map it is cut off in place; from a
+// stream it is copied into whichever name buffer the last record isn't using.
+static char * takeName(seqReader * r, char * line, size_t len) {
+  size_t m = 1;
+  while (m < len && line[m] != ' ' && line[m] != '\t') m++;
+  if (r->map) {
+    line[m] = 0;
+    return line + 1;
+  }
+  int slot = r->names[0] == r->pendingName ? 1 : 0;
+  r->names[slot] = reserve(r->names[slot], &r->nameCap[slot], m);
+  memcpy(r->names[slot], line + 1, m - 1);
+  r->names[slot][m - 1] = 0;
+  return r->names[slot];
+}
+
+// reads the next header, after the records that end at a known length
+static void takeHeader(seqReader * r, char marker) {
+  char * line;
+  size_t len;
+  while (nextLine(r, &line, &len)) {
+    if (len == 0) continue;
+    if (line[0] != marker) {
+      fprintf(stdout, "malformed file at %s\n", r->path);
+      r->failed = true;
+      return;
+    }
+    r->pendingName = takeName(r, line, len);
+    r->pendingData = r->map ? r->map + r->pos : NULL;
+    r->pending = true;
+    return;
+  }
+}
+
+// gives the pages of a streamed map that have been read back to the kernel
+static void releaseMap(seqReader * r) {
+  size_t done = r->pending ? (size_t) (r->pendingName - r->map) : r->pos;
+  if (done - r->released < SEQIO_RELEASE) return;
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t upto = done / page * page;
+  madvise(r->map + r->released, upto - r->released, MADV_DONTNEED);
+  r->released = upto;
+}
+
+// copies n bytes and a terminator into the blocks of a set
+static char * storeBytes(seqSet * set, char * s, size_t n) {
+  if (set->blockUsed + n + 1 > set->blockCap) {
+    set->blockCap = n + 1 > (1 << 20) ? n + 1 : (1 << 20);
+    set->blocks = realloc(set->blocks, sizeof(char *) * (set->nBlocks + 1));
+    set->blocks[set->nBlocks++] = malloc(set->blockCap);
+    set->blockUsed = 0;
+  }
+  char * p = set->blocks[set->nBlocks - 1] + set->blockUsed;
+  memcpy(p, s, n);
+  p[n] = 0;
+  set->blockUsed += n + 1;
+  return p;
+}
+
+
+/**
+ * primary calls
+ */
+
+// opens a FASTA or FASTQ file, plain or gzipped
+seqReader * openSeqReader(char * path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error reading file at %s\n", path);
+    return NULL;
+  }
+  struct stat st;
+  unsigned char magic [2];
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr, "error reading file at %s\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  seqReader * r = calloc(1, sizeof(seqReader));
+  r->path = path;
+  if (pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    r->gz = gzdopen(fd, "rb");
+    if (r->gz == NULL) {
+      fprintf(stderr, "error reading file at %s\n", path);
+      close(fd);
+      free(r);
+      return NULL;
+    }
+    gzbuffer(r->gz, SEQIO_BLOCK);
+    r->buf = reserve(NULL, &r->bufCap, SEQIO_BLOCK);
+    return r;
+  }
+
+  // map one byte more than the file, so the last record can be terminated
+  // even when it has no newline. The file is laid over anonymous pages that
+  // supply that byte when the file ends on a page boundary.
+  size_t page = sysconf(_SC_PAGESIZE);
+  r->size = st.st_size;
+  r->mapLen = (r->size / page + 1) * page;
+  r->map = mmap(NULL, r->mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (r->map == MAP_FAILED || (r->size > 0 &&
+      mmap(r->map, r->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+    fprintf(stderr, "error reading file at %s\n", path);
+    if (r->map != MAP_FAILED) munmap(r->map, r->mapLen);
+    close(fd);
+    free(r);
+    return NULL;
+  }
+  madvise(r->map, r->mapLen, MADV_SEQUENTIAL);
+  close(fd);
+  return r;
+}
+
+// reads the next record, or returns false at the end of the file or on a
+// malformed one (with failed set). The record is valid until the next call.
+//
+// In the map the lines of a record are moved together over its own line
+// endings and terminated where the next header begins, which has already
+// been read by then. Blank lines are skipped, and so are lines starting with
+// ';' in FASTA.
+bool nextSeq(seqReader * r, seqRecord * rec) {
+  if (r->failed) return false;
+  if (r->map && !r->keep) releaseMap(r);
+
+  char * line = NULL;
+  size_t len = 0;
+  char * name;
+  char * dst = NULL; // where the joined sequence goes in the map
+  if (r->pending) {
+    name = r->pendingName;
+    dst = r->pendingData;
+    r->pending = false;
+  } else {
+    // only the first record starts without a header in hand
+    do {
+      if (!nextLine(r, &line, &len)) return false;
+    } while (len == 0 || line[0] == ';');
+    if (line[0] == '>' || line[0] == '@') {
+      r->fastq = line[0] == '@';
+      name = r->pendingName = takeName(r, line, len);
+      dst = r->map ? r->map + r->pos : NULL;
+      line = NULL;
+    } else {
+      // sequence data without a header is its own unnamed record
+      name = "*";
+      dst = line;
+    }
+  }
+
+  // the sequence lines, up to the next header or the '+' line of FASTQ
+  size_t n = 0;
+  bool plus = false;
+  while (line || nextLine(r, &line, &len)) {
+    if (len == 0 || (!r->fastq && line[0] == ';')) {
+      line = NULL;
+      continue;
+    }
+    if (!r->fastq && line[0] == '>') {
+      r->pendingName = takeName(r, line, len);
+      r->pendingData = r->map ? r->map + r->pos : NULL;
+      r->pending = true;
+      break;
+    }
+    if (r->fastq && line[0] == '+') {
+      plus = true;
+      break;
+    }
+    if (r->map) {
+      memmove(dst + n, line, len);
+    } else {
+      r->seqBuf = reserve(r->seqBuf, &r->seqCap, n + len + 1);
+      memcpy(r->seqBuf + n, line, len);
+    }
+    n += len;
+    line = NULL;
+  }
+  if (r->failed) return false;
+
+  // FASTQ qualities may span lines too, and may start with '@', so they are
+  // read up to the length of the sequence
+  char * qual = NULL;
+  size_t q = 0;
+  if (r->fastq) {
+    if (!plus) {
+      fprintf(stdout, "malformed file at %s\n", r->path);
+      r->failed = true;
+      return false;
+    }
+    qual = "";
+    while (q < n && nextLine(r, &line, &len)) {
+      if (r->map) {
+        if (q == 0) qual = line;
+        memmove(qual + q, line, len);
+      } else {
+        r->qualBuf = reserve(r->qualBuf, &r->qualCap, q + len + 1);
+        memcpy(r->qualBuf + q, line, len);
+        qual = r->qualBuf;
+      }
+      q += len;
+    }
+    if (q != n) {
+      fprintf(stdout, "malformed file at %s\n", r->path);
+      r->failed = true;
+      return false;
+    }
+    takeHeader(r, '@');
+    if (r->failed) return false;
+  }
+
+  if (r->map) {
+    dst[n] = 0;
+    if (q > 0) qual[q] = 0;
+    rec->seq = dst;
+  } else {
+    r->seqBuf = reserve(r->seqBuf, &r->seqCap, n + 1);
+    r->seqBuf[n] = 0;
+    if (q > 0) qual[q] = 0;
+    rec->seq = r->seqBuf;
+  }
+  rec->name = name;
+  rec->len = n;
+  rec->qual = qual;
+  return true;
+}
+
+void closeSeqReader(seqReader * r) {
+  if (!r) return;
+  if (r->map) munmap(r->map, r->mapLen);
+  if (r->gz) gzclose(r->gz);
+  free(r->buf);
+  free(r->names[0]);
+  free(r->names[1]);
+  free(r->seqBuf);
+  free(r->qualBuf);
+  free(r);
+}
+
+// reads every record of a file. Records of a plain file are left in the map,
+// and those of a gzip file are copied out of the reader's buffers.
+seqSet * readSeqSet(char * path) {
+  seqReader * r = openSeqReader(path);
+  if (!r) return NULL;
+  r->keep = true;
+
+  seqSet * set = calloc(1, sizeof(seqSet));
+  set->reader = r;
+  set->cap = 64;
+  set->rec = malloc(sizeof(seqRecord) * set->cap);
+  seqRecord rec;
+  while (nextSeq(r, &rec)) {
+    if (set->n == set->cap) {
+      set->cap *= 2;
+      set->rec = realloc(set->rec, sizeof(seqRecord) * set->cap);
+    }
+    if (!r->map) {
+      rec.name = storeBytes(set, rec.name, strlen(rec.name));
+      rec.seq = storeBytes(set, rec.seq, rec.len);
+      if (rec.qual) rec.qual = storeBytes(set, rec.qual, rec.len);
+    }
+    set->rec[set->n++] = rec;
+  }
+  if (r->failed) {
+    freeSeqSet(set);
+    return NULL;
+  }
+  return set;
+}
+
+void freeSeqSet(seqSet * set) {
+  if (!set) return;
+  for (size_t i = 0; i < set->nBlocks; i++) {
+    free(set->blocks[i]);
+  }
+  free(set->blocks);
+  free(set->rec);
+  closeSeqReader(set->reader);
+  free(set);
+}
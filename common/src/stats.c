@@ -0,0 +1,113 @@
+/**********************************************************************
+ * per-phase timings and counters reported with --stats               *
+ * stats.c                                                            *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+static const char * PHASE_NAMES [N_PHASES] = {
+  "load", "pack", "sa", "bwt", "occ", "lcp", "search", "write",
+  "center", "dp_fill", "traceback", "merge"
+};
+
+static const char * COUNTER_NAMES [N_COUNTERS] = {
+  "dp_cells", "backward_steps", "queries", "text_chars", "dp_words"
+};
+
+bool statsOn = false;
+uint64_t statCounts [N_COUNTERS];
+
+static uint64_t phaseNs [N_PHASES];
+static uint64_t phaseCalls [N_PHASES];
+static uint64_t runStart;
+static char * tool = "";
+static char * outPath = NULL; // stderr if NULL
+
+/**
+ * Helper functions
+ */
+
+static uint64_t nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// writes the report as one line of JSON. Phases that never ran and counters
+// that stayed at 0 are left out.
+static void statsReport(void) {
+  FILE * f = outPath ? fopen(outPath, "w") : stderr;
+  if (f == NULL) {
+    fprintf(stderr, "error writing file at %s\n", outPath);
+    return;
+  }
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  fprintf(f, "{\"tool\":\"%s\",\"wall_s\":%.6f,\"peak_rss_kb\":%ld,\"phases\":{",
+    tool, (nowNs() - runStart) * 1e-9, ru.ru_maxrss);
+  bool first = true;
+  for (int k = 0; k < N_PHASES; k++) {
+    if (phaseCalls[k] == 0) continue;
+    fprintf(f, "%s\"%s\":{\"s\":%.6f,\"calls\":%llu}", first ? "" : ",", PHASE_NAMES[k],
+      phaseNs[k] * 1e-9, (unsigned long long) phaseCalls[k]);
+    first = false;
+  }
+  fprintf(f, "},\"counters\":{");
+  first = true;
+  for (int k = 0; k < N_COUNTERS; k++) {
+    if (statCounts[k] == 0) continue;
+    fprintf(f, "%s\"%s\":%llu", first ? "" : ",", COUNTER_NAMES[k], (unsigned long long) statCounts[k]);
+    first = false;
+  }
+  fprintf(f, "}}\n");
+  if (outPath) fclose(f);
+}
+
+
+/**
+ * primary calls
+ */
+
+// takes --stats, or --stats=path to write the report to a file, out of the
+// arguments wherever it is and returns the new argument count. The report is
+// written once when the program exits, covering every command it ran.
+int statsOption(int argc, char ** argv) {
+  int n = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--stats") == 0) {
+      statsOn = true;
+    } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+      statsOn = true;
+      outPath = argv[i] + 8;
+    } else {
+      argv[n++] = argv[i];
+    }
+  }
+  argv[n] = NULL;
+  if (statsOn && runStart == 0) {
+    char * slash = strrchr(argv[0], '/');
+    tool = slash ? slash + 1 : argv[0];
+    runStart = nowNs();
+    atexit(statsReport);
+  }
+  return n;
+}
+
+// the time a phase starts at, to be passed to statsStop
+uint64_t statsStart(void) {
+  return statsOn ? nowNs() : 0;
+}
+
+void statsStop(statPhase phase, uint64_t start) {
+  if (!statsOn) return;
+  __atomic_fetch_add(&phaseNs[phase], nowNs() - start, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&phaseCalls[phase], 1, __ATOMIC_RELAXED);
+}
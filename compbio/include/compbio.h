@@ -0,0 +1,35 @@
+/**********************************************************************
+ * public interface of libcompbio                                     *
+ * compbio.h                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef COMPBIO_H
+#define COMPBIO_H
+
+// sequence input, inputs shared along a chain, packed DNA, alignment and
+// run statistics
+#include "seqio.h"
+#include "context.h"
+#include "packdna.h"
+#include "align.h"
+#include "stats.h"
+
+// Z-algorithm pattern matching
+#include "zalg.h"
+
+// global alignment of a pair of records
+#include "myAlign.h"
+
+// FM-index construction, search, saved indexes, repeats and read mapping
+#include "fmindex.h"
+#include "fmstore.h"
+#include "wavelet.h"
+#include "lcp.h"
+#include "mapper.h"
+#include "fmsearch.h"
+
+// center star MSA
+#include "centerStar.h"
+
+#endif
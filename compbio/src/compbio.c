@@ -0,0 +1,89 @@
+/**********************************************************************
+ * one binary for every tool, with commands chained in one process    *
+ * compbio.c                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compbio.h"
+
+#define CHAIN_SEP "+" // separates the commands of a chain
+
+typedef struct command_S {
+  char *           name;
+  char *           tool;  // the stand-alone binary it stands in for
+  int              (* run)(int, char **, chainContext *);
+} command;
+
+static const command COMMANDS [] = {
+  { "search",  "zalg",        zalgCommand },
+  { "align",   "myAlign",     myAlignCommand },
+  { "fmindex", "fmsearch",    fmsearchCommand },
+  { "msa",     "center_star", centerStarCommand },
+};
+#define N_COMMANDS (sizeof(COMMANDS) / sizeof(command))
+
+/**
+ * Helper functions
+ */
+
+static void usage(void) {
+  fprintf(stdout, "usage: compbio command [args] [+ command [args] ...]\n\n");
+  for (size_t k = 0; k < N_COMMANDS; k++) {
+    fprintf(stdout, "  %-8s takes the arguments of %s\n", COMMANDS[k].name, COMMANDS[k].tool);
+  }
+}
+
+static const command * findCommand(char * name) {
+  for (size_t k = 0; k < N_COMMANDS; k++) {
+    if (strcmp(COMMANDS[k].name, name) == 0) return &COMMANDS[k];
+  }
+  return NULL;
+}
+
+
+/**
+ * primary calls
+ */
+
+// runs each command of the chain in turn, stopping at the first that fails.
+// Every command gets its own copy of its arguments, led by the name of this
+// binary, since the tools rearrange the arguments they are given. The
+// commands share one context, so a file read or an index built by one is
+// not loaded again by the next. --stats anywhere reports on the whole chain.
+int main(int argc, char ** argv) {
+  argc = statsOption(argc, argv);
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  char ** args = malloc(sizeof(char *) * (argc + 1));
+  chainContext * ctx = makeChainContext();
+  int status = 0;
+  int argi = 1;
+  while (argi < argc && status == 0) {
+    int end = argi;
+    while (end < argc && strcmp(argv[end], CHAIN_SEP) != 0) end++;
+    const command * cmd = findCommand(argv[argi]);
+    if (cmd == NULL) {
+      fprintf(stdout, "unknown command %s\n\n", argv[argi]);
+      usage();
+      status = 1;
+      break;
+    }
+    int n = end - argi;
+    args[0] = argv[0];
+    memcpy(args + 1, argv + argi + 1, sizeof(char *) * (n - 1));
+    args[n] = NULL;
+    status = cmd->run(n, args, ctx);
+    fflush(stdout);
+    argi = end + 1;
+  }
+  freeChainContext(ctx);
+  free(args);
+  return status;
+}
@@ -0,0 +1,88 @@
+/**********************************************************************
+ * FM-index construction and backward search                          *
+ * fmindex.h                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef FMINDEX_H
+#define FMINDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wavelet.h"
+
+// separates the records of a multi-sequence text. It sorts before every
+// sequence character, and backward search refuses it in a pattern, so a
+// pattern can never match across two records.
+#define RECORD_SEP '#'
+#define TEXT_END   '$'
+
+// the largest byte a text may hold. The tables below are indexed by byte,
+// and sorting takes the bytes as symbols below 127.
+#define MAX_SYMBOL 126
+
+// whether c may appear in the sequence of a record: a byte above both
+// separators, so they stay unique and sort first, and no larger than
+// MAX_SYMBOL
+static inline bool seqSymbol(char c) {
+  return c > TEXT_END && c <= MAX_SYMBOL;
+}
+
+// the most sequence symbols, separators aside, whose occurrences are kept as
+// one column of counts per symbol. Larger alphabets use a wavelet matrix.
+#define OCC_DENSE_SYMBOLS 4
+
+typedef struct occTable_S {
+  char alph [127];
+  int map [127];
+  int alphn;
+  int n;
+  waveletMatrix * wm; // the string itself, in place of data, over large alphabets
+  int data[];
+} occTable;
+
+// the record boundaries of a multi-sequence text. start[i] is the offset of
+// the first character of record i in the text, and names holds every record
+// name back to back, with nameOff[i] pointing at the name of record i.
+typedef struct recordTable_S {
+  int n;
+  int cap;
+  int * start;
+  int * nameOff;
+  char * names;
+  size_t namesLen;
+  size_t namesCap;
+} recordTable;
+
+typedef struct fmIndex_S {
+  char * s;
+  size_t n;
+  int * SA;
+  char * BW;
+  int * C;
+  occTable * occ;
+  recordTable * records;
+} fmIndex;
+
+bool occNeedsWavelet(char *, size_t);
+occTable * makeOccTable(char *, size_t, waveletMatrix *);
+void freeOccTable(occTable *);
+int fmOcc(occTable *, char, int);
+
+int * suffixArray(char *, size_t);
+char * BWtable(char *, int *, size_t);
+int * Ctable(char *, size_t, int *);
+
+fmIndex * makeFmIndex(char *, size_t, int *, waveletMatrix *, recordTable *);
+void freeFmIndex(fmIndex *);
+bool backwardStep(fmIndex *, char, int *, int *);
+bool fmRange(fmIndex *, char *, size_t, int *, int *);
+
+recordTable * makeRecordTable();
+void addRecord(recordTable *, char *, size_t, int);
+void freeRecordTable(recordTable *);
+int findRecord(recordTable *, int);
+char * recordName(recordTable *, int);
+
+#endif
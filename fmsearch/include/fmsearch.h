@@ -0,0 +1,21 @@
+/**********************************************************************
+ * FM-index search, repeat and read mapping commands                  *
+ * fmsearch.h                                                         *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef FMSEARCH_H
+#define FMSEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "context.h"
+#include "fmindex.h"
+
+char * fmReadRecords(char *, size_t *, recordTable **);
+void fmPrintTables(fmIndex *);
+void fmPrintHits(fmIndex *, char *, int, int, bool);
+int fmsearchCommand(int, char **, chainContext *);
+
+#endif
@@ -0,0 +1,36 @@
+/**********************************************************************
+ * on-disk FM-index made of independently built segments              *
+ * fmstore.h                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef FMSTORE_H
+#define FMSTORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "fmindex.h"
+
+#define FMI_MAGIC   "FMIX"
+#define FMI_VERSION 2 // 2 saves the wavelet matrix of large alphabet segments
+
+// a saved index is a list of segments, oldest first. Appending adds a new
+// segment built from the new records only, and a trailing run of segments is
+// merged back into one whenever the newest is no smaller than half of the one
+// before it. Each character is therefore rebuilt O(log n) times over the
+// life of the index, and a query visits O(log n) segments.
+typedef struct fmCollection_S {
+  int nSeg;
+  fmIndex ** seg;
+} fmCollection;
+
+bool isIndexFile(char *);
+bool writeIndexFile(char *, char *, size_t, recordTable *);
+bool writeIndex(char *, fmIndex *);
+bool appendIndexFile(char *, char *, size_t, recordTable *);
+fmCollection * readIndexFile(char *);
+fmCollection * singleCollection(fmIndex *);
+void freeCollection(fmCollection *);
+
+#endif
@@ -0,0 +1,17 @@
+/**********************************************************************
+ * LCP array and repeat queries on the suffix array                   *
+ * lcp.h                                                              *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef LCP_H
+#define LCP_H
+
+#include "fmindex.h"
+
+int * lcpArray(char *, size_t, int *);
+void maximalRepeats(fmIndex *, int *, int);
+void longestRepeat(fmIndex *, int *);
+bool longestCommon(fmIndex *, int *, char *, char *);
+
+#endif
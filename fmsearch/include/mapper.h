@@ -0,0 +1,43 @@
+/**********************************************************************
+ * seed-and-extend read mapping on the FM-index                       *
+ * mapper.h                                                           *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include "fmindex.h"
+#include "fmstore.h"
+#include "seqio.h"
+#include "packdna.h"
+#include "arena.h"
+
+// an exact match of read[q, q + len) with text[t, t + len) in a segment
+typedef struct seed_S {
+  int q;
+  int t;
+  int len;
+  int seg;
+} seed;
+
+typedef struct mapParams_S {
+  int minSeed;   // shortest SMEM used as a seed
+  int maxOcc;    // SMEMs with more occurrences than this are skipped
+  int band;      // extra diagonals on either side of the alignment band
+  int lookback;  // earlier seeds each seed may be chained to
+  int match;
+  int mismatch;
+  int indel;
+} mapParams;
+
+#define MAP_MIN_SEED 11
+#define MAP_MAX_OCC  64
+#define MAP_BAND     8
+#define MAP_LOOKBACK 50
+
+int findSmems(fmCollection *, char *, int, mapParams *, seed **);
+int chainSeeds(fmCollection *, seed *, int, mapParams *, int *);
+bool mapReads(fmCollection *, seqReader *, mapParams *);
+
+#endif
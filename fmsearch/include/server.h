@@ -0,0 +1,28 @@
+/**********************************************************************
+ * FM-index query server and client over a Unix domain socket         *
+ * server.h                                                           *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+
+#include "fmstore.h"
+
+#define SERVER_BATCH    256     // most requests answered in one batch
+#define SERVER_MAX_LINE (1 << 20) // longest request line a client may send
+#define CLIENT_WINDOW   64      // requests a client sends before reading replies
+
+// Requests and replies are single lines. A request is an operation and a
+// pattern, and the reply is
+//   count P   the number of occurrences of P
+//   range P   segment:st-ed for each segment P occurs in, space separated
+//   locate P  record:offset for each occurrence of P, in text order
+// or "error" and a message. Replies to a client come in the order of its
+// requests.
+bool serveIndex(fmCollection *, char *, int);
+bool queryServer(char *, int, char **);
+
+#endif
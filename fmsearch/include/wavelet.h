@@ -0,0 +1,39 @@
+/**********************************************************************
+ * wavelet matrix for rank queries over large alphabets               *
+ * wavelet.h                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef WAVELET_H
+#define WAVELET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// words of 64 bits covered by one cumulative rank sample
+#define WM_BLOCK_WORDS 4
+
+// a string over the symbol codes 0..alphn-1 stored as one bit vector per bit
+// of the code, most significant first. Each level is stably partitioned by
+// its bit before the next, so counting a symbol takes one pair of bit vector
+// ranks per level: O(log alphn) time in about log2(alphn) bits per symbol.
+typedef struct waveletMatrix_S {
+  int levels;
+  size_t n;
+  size_t nWords;      // 64 bit words per level
+  size_t nBlocks;     // rank samples per level
+  size_t zeros [8];   // number of 0 bits on each level
+  uint64_t * bits;    // levels * nWords
+  uint32_t * blocks;  // count of 1 bits before each block, levels * nBlocks
+} waveletMatrix;
+
+waveletMatrix * makeWaveletMatrix(char *, size_t, int *, int);
+size_t waveletRank(waveletMatrix *, int, size_t);
+uint64_t waveletBytes(waveletMatrix *);
+bool writeWaveletMatrix(FILE *, waveletMatrix *);
+waveletMatrix * readWaveletMatrix(FILE *);
+void freeWaveletMatrix(waveletMatrix *);
+
+#endif
@@ -0,0 +1,427 @@
+/**********************************************************************
+ * FM-index construction and backward search                          *
+ * fmindex.c                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fmindex.h"
+#include "stats.h"
+
+/**
+ * Helper functions
+ */
+
+// SA-IS suffix sorting (Nong, Zhang & Chan). Every suffix is typed S if it is
+// smaller than the suffix after it and L otherwise, and the leftmost S-type
+// suffixes of each run (LMS) are sorted first, recursively if their substrings
+// aren't all distinct. The order of every other suffix is then induced from
+// theirs in two linear scans. s is a string of n symbols under K, read as
+// bytes if cs is 1 and ints otherwise, whose last symbol is a unique 0.
+
+#define chr(i) (cs == sizeof(int) ? ((int *) s)[i] : ((unsigned char *) s)[i])
+#define isS(i) ((t[(i) / 8] >> ((i) % 8)) & 1)
+#define isLMS(i) ((i) > 0 && isS(i) && !isS((i) - 1))
+
+// finds the start (or end) of each symbol's bucket in the suffix array
+static void getBuckets(void * s, int * bkt, int n, int K, int cs, bool end) {
+  int sum = 0;
+  memset(bkt, 0, sizeof(int) * (K + 1));
+  for (int i = 0; i < n; i++) bkt[chr(i)]++;
+  for (int i = 0; i <= K; i++) {
+    sum += bkt[i];
+    bkt[i] = end ? sum : sum - bkt[i];
+  }
+}
+
+// places each L-type suffix at the front of its bucket, left to right
+static void induceL(uint8_t * t, int * SA, void * s, int * bkt, int n, int K, int cs) {
+  getBuckets(s, bkt, n, K, cs, false);
+  for (int i = 0; i < n; i++) {
+    int j = SA[i] - 1;
+    if (j >= 0 && !isS(j)) SA[bkt[chr(j)]++] = j;
+  }
+}
+
+// places each S-type suffix at the back of its bucket, right to left
+static void induceS(uint8_t * t, int * SA, void * s, int * bkt, int n, int K, int cs) {
+  getBuckets(s, bkt, n, K, cs, true);
+  for (int i = n - 1; i >= 0; i--) {
+    int j = SA[i] - 1;
+    if (j >= 0 && isS(j)) SA[--bkt[chr(j)]] = j;
+  }
+}
+
+static void sais(void * s, int * SA, int n, int K, int cs) {
+  uint8_t * t = calloc(n / 8 + 1, 1);
+  int * bkt = malloc(sizeof(int) * (K + 1));
+
+  // classify the suffixes. The sentinel is S-type.
+  t[(n - 1) / 8] |= 1 << ((n - 1) % 8);
+  for (int i = n - 2; i >= 0; i--) {
+    if (chr(i) < chr(i + 1) || (chr(i) == chr(i + 1) && isS(i + 1))) {
+      t[i / 8] |= 1 << (i % 8);
+    }
+  }
+
+  // sort the LMS substrings by inducing from their bucket ends
+  getBuckets(s, bkt, n, K, cs, true);
+  for (int i = 0; i < n; i++) SA[i] = -1;
+  for (int i = 1; i < n; i++) {
+    if (isLMS(i)) SA[--bkt[chr(i)]] = i;
+  }
+  induceL(t, SA, s, bkt, n, K, cs);
+  induceS(t, SA, s, bkt, n, K, cs);
+
+  // gather the sorted LMS positions at the front, and name each by its
+  // substring so equal substrings share a name
+  int n1 = 0;
+  for (int i = 0; i < n; i++) {
+    if (isLMS(SA[i])) SA[n1++] = SA[i];
+  }
+  for (int i = n1; i < n; i++) SA[i] = -1;
+  int name = 0;
+  int prev = -1;
+  for (int i = 0; i < n1; i++) {
+    int pos = SA[i];
+    bool diff = false;
+    for (int d = 0; d < n; d++) {
+      if (prev == -1 || chr(pos + d) != chr(prev + d) || isS(pos + d) != isS(prev + d)) {
+        diff = true;
+        break;
+      } else if (d > 0 && (isLMS(pos + d) || isLMS(prev + d))) {
+        break;
+      }
+    }
+    if (diff) {
+      name++;
+      prev = pos;
+    }
+    SA[n1 + pos / 2] = name - 1;
+  }
+  for (int i = n - 1, j = n - 1; i >= n1; i--) {
+    if (SA[i] >= 0) SA[j--] = SA[i];
+  }
+
+  // sort the reduced string of names
+  int * SA1 = SA;
+  int * s1 = SA + n - n1;
+  if (name < n1) {
+    sais(s1, SA1, n1, name - 1, sizeof(int));
+  } else {
+    for (int i = 0; i < n1; i++) SA1[s1[i]] = i;
+  }
+
+  // put the LMS suffixes in their final order at their bucket ends, and
+  // induce the rest from them
+  getBuckets(s, bkt, n, K, cs, true);
+  for (int i = 1, j = 0; i < n; i++) {
+    if (isLMS(i)) s1[j++] = i;
+  }
+  for (int i = 0; i < n1; i++) SA1[i] = s1[SA1[i]];
+  for (int i = n1; i < n; i++) SA[i] = -1;
+  for (int i = n1 - 1; i >= 0; i--) {
+    int j = SA[i];
+    SA[i] = -1;
+    SA[--bkt[chr(j)]] = j;
+  }
+  induceL(t, SA, s, bkt, n, K, cs);
+  induceS(t, SA, s, bkt, n, K, cs);
+
+  free(bkt);
+  free(t);
+}
+
+#undef chr
+#undef isS
+#undef isLMS
+
+// Gets the alphabet of a given string
+static char * sAlph(char * s, size_t n) {
+  bool memo [128];
+  memset(memo, false, sizeof(bool) * 128);
+
+  for (size_t i = 0; i < n; i++) {
+    memo[(unsigned char) s[i]] = true;
+  }
+
+#ifdef DEBUG
+  for (int i = 0; i < 128; i++) {
+    fprintf(stdout, "%3d: %s\n", i, memo[i] ? "true" : "false");
+  }
+#endif
+
+  char * alph = malloc(sizeof(char) * 128);
+
+  int index = 0;
+  for (int i = 0; i < 128; i++) {
+    if (memo[i]) {
+      alph[index++] = i;
+    }
+  }
+  alph[index] = 0;
+  return alph;
+}
+
+
+/**
+ * primary calls
+ */
+
+// takes a string and turns it into a suffix array with sorting
+int * suffixArray(char * s, size_t n) {
+  // sort the text along with its NUL, which is the smallest symbol. The text
+  // ends in a unique terminator, so this is the same order strcmp gives the
+  // suffixes, and the NUL's own suffix sorts first and is dropped.
+  uint64_t t0 = statsStart();
+  int * SA = malloc(sizeof(int) * (n + 1));
+  sais(s, SA, n + 1, 127, 1);
+  int * arr = malloc(sizeof(int) * n);
+  memcpy(arr, SA + 1, sizeof(int) * n);
+  free(SA);
+  statsStop(PHASE_SA, t0);
+#ifdef DEBUG
+  for (int i = 0; i < n; i++) {
+    fprintf(stdout, "% 2d ", arr[i]);
+  }
+  fprintf(stdout, "\n");
+#endif
+  return arr;
+}
+
+// Turns an array into a BW string
+char * BWtable(char * s, int * SA, size_t n) {
+  char * BW = malloc(sizeof(char) * (n + 1));
+  for (size_t i = 0; i < n; i++) {
+    int index = SA[i] - 1;
+    if (index < 0) index = n - 1;
+    BW[i] = s[index];
+  }
+  BW[n] = 0;
+  return BW;
+}
+
+// Gets the count table from a string using a suffix array
+int * Ctable(char * s, size_t n, int * SA) {
+  int * C = malloc(sizeof(int) * 128);
+  memset(C, 0, sizeof(int) * 128);
+  int * SAp = SA;
+  if (!SA) {
+    SAp = suffixArray(s, n);
+  }
+
+  char lc = s[SAp[0]];
+  C[lc + 1] += 1;
+  for (size_t i = 1; i < n; i++) {
+    char c = s[SAp[i]];
+    if (c >= 127) break;
+    if (c == lc) {
+      C[c + 1] += 1;
+      continue;
+    }
+    int j = lc + 2;
+    for (; j <= c + 1; j++) {
+      C[j] = C[j - 1];
+    }
+    C[c + 1] += 1;
+    lc = c;
+  }
+  for (int i = lc + 2; i < 128; i++) {
+    C[i] = C[i - 1];
+  }
+
+  if (!SA) {
+    free(SAp);
+  }
+  return C;
+}
+
+// whether the occurrences in s are kept as a wavelet matrix: when s has more
+// than OCC_DENSE_SYMBOLS symbols besides the separators
+bool occNeedsWavelet(char * s, size_t n) {
+  char * alph = sAlph(s, n);
+  int symbols = 0;
+  for (int i = 0; alph[i]; i++) {
+    if (alph[i] != TEXT_END && alph[i] != RECORD_SEP) symbols++;
+  }
+  free(alph);
+  return symbols > OCC_DENSE_SYMBOLS;
+}
+
+// returns an occurrence table struct for a given string. Over a large
+// alphabet the table holds a wavelet matrix of the string instead of the
+// counts, wm if one was saved with the index or a new one otherwise.
+occTable * makeOccTable(char * s, size_t n, waveletMatrix * wm) {
+  char * alph = sAlph(s, n);
+  int alphn = strlen(alph);
+  bool dense = wm == NULL && !occNeedsWavelet(s, n);
+  size_t cells = dense ? (size_t) alphn * n : 0;
+  occTable * table = malloc(sizeof(occTable) + sizeof(int) * cells);
+  memset(table, 0, sizeof(occTable) + sizeof(int) * cells);
+  table->alphn = alphn;
+  table->n = n;
+  memcpy(table->alph, alph, sizeof(char) * alphn);
+  for (int i = 0; i < alphn; i++) {
+    table->map[(unsigned char) alph[i]] = i;
+  }
+  free(alph);
+  if (!dense) {
+    table->wm = wm ? wm : makeWaveletMatrix(s, n, table->map, alphn);
+    return table;
+  }
+  for (size_t i = 0; i < n; i++) {
+    table->data[n * table->map[(unsigned char) s[i]] + i]++;
+    if (i == 0) continue;
+    for (int j = 0; j < alphn; j++) {
+      table->data[n * j + i] += table->data[n * j + i - 1];
+    }
+  }
+  return table;
+}
+
+void freeOccTable(occTable * table) {
+  if (!table) return;
+  freeWaveletMatrix(table->wm);
+  free(table);
+}
+
+// gets a character's occurrence given a particular table
+int fmOcc(occTable * table, char c, int i) {
+  if (i < 0) return 0;
+  if (i >= table->n) i = table->n - 1;
+  unsigned char k = c;
+  if (table->wm) return waveletRank(table->wm, table->map[k], i + 1);
+  return table->data[table->map[k] * table->n + i];
+}
+
+
+// builds every table needed for backward search over s. The index takes
+// ownership of s, SA, wm and the record table. If SA is NULL it is built
+// here, and wm is the saved wavelet matrix of the BW string or NULL.
+fmIndex * makeFmIndex(char * s, size_t n, int * SA, waveletMatrix * wm, recordTable * records) {
+  fmIndex * index = malloc(sizeof(fmIndex));
+  index->s = s;
+  index->n = n;
+  index->SA = SA ? SA : suffixArray(s, n);
+  uint64_t t0 = statsStart();
+  index->BW = BWtable(s, index->SA, n);
+  statsStop(PHASE_BWT, t0);
+  t0 = statsStart();
+  index->C = Ctable(s, n, index->SA);
+  index->occ = makeOccTable(index->BW, n, wm);
+  statsStop(PHASE_OCC, t0);
+  index->records = records;
+  return index;
+}
+
+void freeFmIndex(fmIndex * index) {
+  if (!index) return;
+  free(index->s);
+  free(index->SA);
+  free(index->BW);
+  free(index->C);
+  freeOccTable(index->occ);
+  freeRecordTable(index->records);
+  free(index);
+}
+
+// extends the suffix array range [st, ed] of some string P to the range of
+// cP. returns false if cP does not occur. A separator never matches, so no
+// match can span two records or run past the end of the text.
+bool backwardStep(fmIndex * index, char c, int * pst, int * ped) {
+  // a character that isn't in the text can't match
+  unsigned char k = c;
+  if (!seqSymbol(c) || index->C[k] == index->C[k + 1]) {
+    *pst = 1;
+    *ped = 0;
+    return false;
+  }
+  *pst = index->C[k] + fmOcc(index->occ, c, *pst - 1);
+  *ped = index->C[k] + fmOcc(index->occ, c, *ped) - 1;
+  return *pst <= *ped;
+}
+
+// The FMsearch algorithm. finds the range of the given pattern q in the
+// suffix array of the index. returns false if q does not occur, which
+// includes any q holding a separator or a byte no record can hold.
+bool fmRange(fmIndex * index, char * q, size_t m, int * pst, int * ped) {
+  int st = 0;
+  int ed = index->n - 1;
+  int i = m - 1;
+  for (; i >= 0 && st <= ed; i--){
+    backwardStep(index, q[i], &st, &ed);
+#ifdef DEBUG
+    fprintf(stdout, "Step %d: x = %c, st = %d, ed = %d\n", m - i, q[i], st, ed);
+#endif
+  }
+  statsAdd(COUNT_BACKWARD_STEPS, m - 1 - i);
+  *pst = st;
+  *ped = ed;
+  return st <= ed;
+}
+
+
+/**
+ * record table
+ */
+
+recordTable * makeRecordTable() {
+  recordTable * table = malloc(sizeof(recordTable));
+  table->n = 0;
+  table->cap = 16;
+  table->start = malloc(sizeof(int) * table->cap);
+  table->nameOff = malloc(sizeof(int) * table->cap);
+  table->namesLen = 0;
+  table->namesCap = 256;
+  table->names = malloc(table->namesCap);
+  return table;
+}
+
+// appends a record named by the first m characters of name that begins at
+// offset start in the text
+void addRecord(recordTable * table, char * name, size_t m, int start) {
+  if (table->n == table->cap) {
+    table->cap *= 2;
+    table->start = realloc(table->start, sizeof(int) * table->cap);
+    table->nameOff = realloc(table->nameOff, sizeof(int) * table->cap);
+  }
+  while (table->namesLen + m + 1 > table->namesCap) {
+    table->namesCap *= 2;
+    table->names = realloc(table->names, table->namesCap);
+  }
+  table->start[table->n] = start;
+  table->nameOff[table->n] = table->namesLen;
+  memcpy(table->names + table->namesLen, name, m);
+  table->namesLen += m;
+  table->names[table->namesLen++] = 0;
+  table->n++;
+}
+
+void freeRecordTable(recordTable * table) {
+  if (!table) return;
+  free(table->start);
+  free(table->nameOff);
+  free(table->names);
+  free(table);
+}
+
+// finds the record that contains the text position pos with a binary search
+// over the record starts
+int findRecord(recordTable * table, int pos) {
+  int l = 0;
+  int r = table->n - 1;
+  while (l < r) {
+    int mid = (l + r + 1) / 2;
+    if (table->start[mid] <= pos) l = mid;
+    else r = mid - 1;
+  }
+  return l;
+}
+
+char * recordName(recordTable * table, int i) {
+  return table->names + table->nameOff[i];
+}
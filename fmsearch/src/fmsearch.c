@@ -9,28 +9,73 @@
 #include <stdint.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+
+#include "fmindex.h"
+#include "fmstore.h"
+#include "mapper.h"
+#include "lcp.h"
+#include "stats.h"
+#include "fmsearch.h"
+#include "server.h"
+
+static void releaseCollection(void * col) {
+  freeCollection(col);
+}
 
-typedef struct occTable_S {
-  char alph [127];
-  int map [127];
-  int alphn;
-  int n;
-  int data[];
-} occTable;
-
-occTable * makeOccTable(char *, size_t);
-int getOcc(occTable *, char, int);
-
-char * sAlph(char * s, size_t n);
-
-int * suffixArray(char *, size_t);
-char * BWtable(char *, int *, size_t);
-int * Ctable(char *, size_t, int *);
-void range(char *, char *, size_t, size_t);
-
-int main(int argc, char ** argv) {
+// fmsearch [options] file [pattern]: searches, saves or maps reads against
+// an FM-index built from a FASTA file or loaded from a saved index. ctx
+// holds the inputs of a chain, or is NULL.
+int fmsearchCommand(int argc, char ** argv, chainContext * ctx) {
+  argc = statsOption(argc, argv);
   bool findrange = false;
+  bool locateOnly = false; // only print the hits, not the tables
+  char * writePath = NULL; // index file to build from the FASTA file
+  char * appendPath = NULL; // index file to add the FASTA file's records to
+  char * readsPath = NULL; // FASTA or FASTQ file of reads to map against the text
+  int repeatLen = 0; // print the maximal repeats at least this long
+  bool longest = false; // print the longest repeated substring
+  char * common [2] = { NULL, NULL }; // records to find the longest common substring of
+  char * servePath = NULL; // socket to answer queries on
+  char * queryPath = NULL; // socket of a server to send queries to
+  long nThreads = sysconf(_SC_NPROCESSORS_ONLN); // server worker threads
   char * q = NULL;
+
+  // consume the option flags
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; argi++) {
+    if (strcmp(argv[argi], "-l") == 0) {
+      locateOnly = true;
+    } else if (strcmp(argv[argi], "-w") == 0 && argi + 1 < argc) {
+      writePath = argv[++argi];
+    } else if (strcmp(argv[argi], "-a") == 0 && argi + 1 < argc) {
+      appendPath = argv[++argi];
+    } else if (strcmp(argv[argi], "-m") == 0 && argi + 1 < argc) {
+      readsPath = argv[++argi];
+    } else if (strcmp(argv[argi], "-r") == 0 && argi + 1 < argc) {
+      repeatLen = atoi(argv[++argi]);
+      if (repeatLen < 1) repeatLen = 1;
+    } else if (strcmp(argv[argi], "-L") == 0) {
+      longest = true;
+    } else if (strcmp(argv[argi], "-c") == 0 && argi + 2 < argc) {
+      common[0] = argv[++argi];
+      common[1] = argv[++argi];
+    } else if (strcmp(argv[argi], "-S") == 0 && argi + 1 < argc) {
+      servePath = argv[++argi];
+    } else if (strcmp(argv[argi], "-q") == 0 && argi + 1 < argc) {
+      queryPath = argv[++argi];
+    } else if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) {
+      nThreads = atoi(argv[++argi]);
+    } else {
+      fprintf(stdout, "unknown option %s\n", argv[argi]);
+      return 1;
+    }
+  }
+  // a client sends the rest of the arguments, or stdin, to a server
+  if (queryPath) return queryServer(queryPath, argc - argi, argv + argi) ? 0 : 1;
+  argc -= argi - 1;
+  argv += argi - 1;
+
   if (argc < 2 || argc >= 4) {
     fprintf(stdout, "malformed arguments\n");
     return 1;
@@ -39,63 +84,130 @@ int main(int argc, char ** argv) {
     q = argv[2];
   }
 
-  char * s = NULL;   // the S string, and the pointer to the entire char buffer
-  FILE * pFile = fopen(argv[1], "r"); // pointer to the given file
-  if (pFile == NULL) {
-    fprintf(stderr, "error reading file at %s\n", argv[1]);
+  // a saved index can be searched but not rebuilt from
+  bool savedIndex = isIndexFile(argv[1]);
+  if (savedIndex && (writePath || appendPath)) {
+    fprintf(stdout, "expected a FASTA file, got the index at %s\n", argv[1]);
     return 1;
   }
 
-  fseek(pFile, 0L, SEEK_END);
-  size_t fsize = ftell(pFile); // the size of the file
-  fseek(pFile, 0L, SEEK_SET);
-
-  // We will now read the file into the text string
-  s = malloc(fsize);
-  char * next = s; // pointer to the next position in the string to read the file line into
+  // an index kept by an earlier command of the chain is used as it is
+  fmCollection * col = findInput(ctx, INPUT_FM_INDEX, argv[1]);
+  if (col == NULL && savedIndex) {
+    col = readIndexFile(argv[1]);
+    if (!col) return 1;
+    if (ctx) keepInput(ctx, INPUT_FM_INDEX, argv[1], col, releaseCollection);
+  } else if (col == NULL || appendPath) {
+    size_t n = 0;
+    recordTable * records = NULL;
+    uint64_t t0 = statsStart();
+    char * s = fmReadRecords(argv[1], &n, &records);
+    if (!s) return 1;
+    statsStop(PHASE_LOAD, t0);
+#ifdef DEBUG
+    fprintf(stdout, "%llu\n", n);
+    fprintf(stdout, "%s\n", s);
+#endif
+    if (appendPath) {
+      // the index kept for the file, if any, no longer matches it
+      dropInput(ctx, INPUT_FM_INDEX, appendPath);
+      return appendIndexFile(appendPath, s, n, records) ? 0 : 1;
+    }
+    if (writePath && !ctx) return writeIndexFile(writePath, s, n, records) ? 0 : 1;
+    col = singleCollection(makeFmIndex(s, n, NULL, NULL, records));
+    if (ctx) keepInput(ctx, INPUT_FM_INDEX, argv[1], col, releaseCollection);
+  }
 
-  while (!feof(pFile)) {
-    // the upper bound to read characters into the text string
-    size_t n = fsize - (next - s);
+  // in a chain the index is built in memory, and is what reading the saved
+  // file back would give, so it is kept for that path too
+  if (writePath) {
+    bool ok = writeIndex(writePath, col->seg[0]);
+    if (ok) keepInput(ctx, INPUT_FM_INDEX, writePath, col, releaseCollection);
+    else dropInput(ctx, INPUT_FM_INDEX, writePath);
+    return ok ? 0 : 1;
+  }
 
-    // read the next file line into the text string at 'next'
-    getline(&next, &n, pFile);
+  if (servePath) {
+    bool ok = serveIndex(col, servePath, nThreads);
+    if (!ctx) freeCollection(col);
+    return ok ? 0 : 1;
+  }
 
-    // find the next instance of \n, \r, >, or ';', and set that to next
-    // This will have the effect of overwriting the string starting at any
-    // of these characters. This will erase comments, and will remove the
-    // carriage returns or newline characters.
-    next = strpbrk(next, "\n\r>;");
+  if (readsPath) {
+    seqReader * reads = openSeqReader(readsPath);
+    bool ok = false;
+    if (reads) {
+      mapParams params = { MAP_MIN_SEED, MAP_MAX_OCC, MAP_BAND, MAP_LOOKBACK, 0, -1, -1 };
+      ok = mapReads(col, reads, &params);
+      closeSeqReader(reads);
+    }
+    if (!ctx) freeCollection(col);
+    return ok ? 0 : 1;
   }
 
-  // sets the final newline/carriage return to 0 if it exists.
-  if (next) {
-    next[0] = '$';
-    next[1] = 0;
+  // repeat queries run over each segment's LCP array in turn
+  if (repeatLen || longest || common[0]) {
+    bool found = false;
+    for (int k = 0; k < col->nSeg; k++) {
+      fmIndex * index = col->seg[k];
+      uint64_t t0 = statsStart();
+      int * LCP = lcpArray(index->s, index->n, index->SA);
+      statsStop(PHASE_LCP, t0);
+      if (repeatLen) maximalRepeats(index, LCP, repeatLen);
+      if (longest) longestRepeat(index, LCP);
+      if (common[0]) found |= longestCommon(index, LCP, common[0], common[1]);
+      free(LCP);
+    }
+    if (common[0] && !found) {
+      fprintf(stdout, "no index segment holds both %s and %s\n", common[0], common[1]);
+    }
+    if (!ctx) freeCollection(col);
+    return 0;
   }
-  else {
-    fprintf(stdout, "malformed file at %s\n", argv[1]);
-    free(s);
-    fclose(pFile);
-    return 1;
+
+  for (int k = 0; k < col->nSeg; k++) {
+    fmIndex * index = col->seg[k];
+    if (!locateOnly) {
+      if (col->nSeg > 1) fprintf(stdout, "Segment %d:\n\n", k + 1);
+      fmPrintTables(index);
+    }
+    if (!findrange) continue;
+
+    int st, ed;
+    uint64_t t0 = statsStart();
+    bool found = fmRange(index, q, strlen(q), &st, &ed);
+    statsStop(PHASE_SEARCH, t0);
+    statsAdd(COUNT_QUERIES, 1);
+    if (locateOnly) {
+      if (found) fmPrintHits(index, q, st, ed, true);
+      continue;
+    }
+    fprintf(stdout, "\n");
+    fprintf(stdout, "S = %s\n", index->s);
+    if (found) {
+      fprintf(stdout, "range(S, %s) = [%d, %d]\n", q, st, ed);
+      fmPrintHits(index, q, st, ed, false);
+    } else {
+      fprintf(stdout, "%s not found\n", q);
+    }
+    if (k + 1 < col->nSeg) fprintf(stdout, "\n");
   }
-  size_t n = strlen(s);
-  fclose(pFile);
-#ifdef DEBUG
-  fprintf(stdout, "%llu\n", n);
-  fprintf(stdout, "%s\n", s);
-#endif
-  int * SA = suffixArray(s, n);
-  char * BW = BWtable(s, SA, n);
-  int * C = Ctable(s, n, SA);
-  char * alph = sAlph(s, n);
-  occTable * table = makeOccTable(BW, n);
+
+  if (!ctx) freeCollection(col);
+  return 0;
+}
+
+// prints the BW string, the C table and the occurrence table of an index
+void fmPrintTables(fmIndex * index) {
+  size_t n = index->n;
+  char * BW = index->BW;
+  int * C = index->C;
+  occTable * table = index->occ;
   
   if (BW) fprintf(stdout, "BW = %s\n\n", BW);
-  if (C) {
-    int alphn = strlen(alph);
-    for (int i = 1; i < alphn; i++) {
-      fprintf(stdout, "C[%c] = %d\n", alph[i], C[alph[i]]);
+  if (C && table) {
+    for (int i = 1; i < table->alphn; i++) {
+      fprintf(stdout, "C[%c] = %d\n", table->alph[i], C[(unsigned char) table->alph[i]]);
     }
   }
   fprintf(stdout, "\n");
@@ -114,216 +226,87 @@ int main(int argc, char ** argv) {
     for (int i = 0; i < table->n; i++) {
       fprintf(stdout, "%*d: ", width, i);
       for (int j = 0; j < table->alphn; j++) {
-        fprintf(stdout, "%*d", width+1, getOcc(table, table->alph[j], i));
+        fprintf(stdout, "%*d", width+1, fmOcc(table, table->alph[j], i));
       }
       fprintf(stdout, "\n");
     }
   }
-  if (findrange) {
-    fprintf(stdout, "\n");
-    range(s, q, n, strlen(q));
-  }
-
-  if (SA) free(SA);
-  if (BW) free(BW);
-  if (C)  free(C);
-  if (alph) free(alph);
-  if (table) free(table);
 }
 
-/**
- * Helper functions
- */
-
-// sorts the array using the provided string and pointers
-void sort(char * s, int * arr, int l, int r) {
-  if (l >= r) return;
-  int tmp [r - l + 1];
-  // store the left and right as backups
-  int lb = l;
-  int rb = r;
-  int pivot = (lb + rb) / 2;
-  for (int i = lb; i <= rb; i++) {
-    // don't need to sort the pivot
-    if (i == pivot) continue;
-    // if the string pointed to by the value in the array at i
-    // is less than the value pointed to by the pivot, push
-    // its index to the far left of the temporary array, otherwise
-    // push it to the right. Then, update the l/r value to point
-    // to the furthest available spot.
-    int res = strcmp(&s[arr[i]], &s[arr[pivot]]);
-    if (res < 0) {
-      tmp[l - lb] = arr[i];
-      l += 1;
-    } else {
-      tmp[r - lb] = arr[i];
-      r -= 1;
+// reads every record of a FASTA or FASTQ file into one text. Records are
+// joined by RECORD_SEP and the text is closed by TEXT_END, and the start and
+// name of each record is kept in the record table.
+char * fmReadRecords(char * path, size_t * pn, recordTable ** precords) {
+  seqReader * reader = openSeqReader(path);
+  if (reader == NULL) return NULL;
+
+  // a mapped file bounds the text, and a stream is grown into
+  size_t cap = reader->map ? reader->size + 2 : 1 << 20;
+  char * s = malloc(cap);
+  size_t n = 0;
+  recordTable * records = makeRecordTable();
+
+  seqRecord rec;
+  bool failed = false;
+  while (nextSeq(reader, &rec)) {
+    // bytes the index cannot sort or that would pass for a separator
+    for (size_t i = 0; i < rec.len && !failed; i++) {
+      if (!seqSymbol(rec.seq[i])) {
+        fprintf(stdout, "unsupported character %d in %s at %s\n", (unsigned char) rec.seq[i], rec.name, path);
+        failed = true;
+      }
     }
-  }
-  // either l or r will point to the middle, this is arbitrary.
-  // put the pivot in that spot
-  arr[l] = arr[pivot];
-  for (int i = lb; i <= rb; i++) {
-    // fill the main array with the values stored in the temp
-    // array, skipping the pivot's position, of course.
-    if (i == l) continue;
-    arr[i] = tmp[i - lb];
-  }
-  // recursive calls to the subarrays
-  sort(s, arr, lb, r - 1);
-  sort(s, arr, l + 1, rb);
-}
-
-// Gets the alphabet of a given string
-char * sAlph(char * s, size_t n) {
-  bool memo [128];
-  memset(memo, false, sizeof(bool) * 128);
-  int size = 0;
-
-  for (int i = 0; i < n; i++) {
-    memo[s[i]] = true;
-  }
-
-#ifdef DEBUG
-  for (int i = 0; i < 128; i++) {
-    fprintf(stdout, "%3d: %s\n", i, memo[i] ? "true" : "false");
-  }
-#endif
-
-  char * alph = malloc(sizeof(char) * 128);
-
-  int index = 0;
-  for (int i = 0; i < 128; i++) {
-    if (memo[i]) {
-      alph[index++] = i;
+    if (failed) break;
+    while (n + rec.len + 2 > cap) {
+      cap *= 2;
+      s = realloc(s, cap);
     }
+    if (records->n > 0) s[n++] = RECORD_SEP;
+    addRecord(records, rec.name, strlen(rec.name), n);
+    memcpy(s + n, rec.seq, rec.len);
+    n += rec.len;
   }
-  alph[index] = 0;
-  return alph;
-}
-
+  bool empty = !failed && !reader->failed && records->n == 0;
+  failed |= reader->failed;
+  closeSeqReader(reader);
 
-/**
- * primary calls
- */
-
-// takes a string and turns it into a suffix array with sorting
-int * suffixArray(char * s, size_t n) {
-  int * arr = malloc(sizeof(int) * n);
-  // fill the array with 0 - n. These represent addresses within
-  // the string array that will be used for comparison later.
-  for (int i = 0; i < n; i++) {
-    arr[i] = i;
-  }
-  sort(s, arr, 0, n - 1);
-#ifdef DEBUG
-  for (int i = 0; i < n; i++) {
-    fprintf(stdout, "% 2d ", arr[i]);
+  if (failed || empty) {
+    if (empty) fprintf(stdout, "malformed file at %s\n", path);
+    freeRecordTable(records);
+    free(s);
+    return NULL;
   }
-  fprintf(stdout, "\n");
-#endif
-  return arr;
-}
+  s[n++] = TEXT_END;
+  s[n] = 0;
 
-// Turns an array into a BW string
-char * BWtable(char * s, int * SA, size_t n) {
-  char * BW = malloc(sizeof(char) * (n + 1));
-  for (int i = 0; i < n; i++) {
-    int index = SA[i] - 1;
-    if (index < 0) index = n - 1;
-    BW[i] = s[index];
-  }
-  BW[n] = 0;
-  return BW;
+  *pn = n;
+  *precords = records;
+  return s;
 }
 
-// Gets the count table from a string using a suffix array
-int * Ctable(char * s, size_t n, int * SA) {
-  int * C = malloc(sizeof(int) * 128);
-  memset(C, 0, sizeof(int) * 128);
-  int * SAp = SA;
-  if (!SA) {
-    SAp = suffixArray(s, n);
-  }
-
-  char lc = s[SAp[0]];
-  C[lc + 1] += 1;
-  for (int i = 1; i < n; i++) {
-    char c = s[SAp[i]];
-    if (c >= 127) break;
-    if (c == lc) {
-      C[c + 1] += 1;
-      continue;
-    }
-    int j = lc + 2;
-    for (; j <= c + 1; j++) {
-      C[j] = C[j - 1];
-    }
-    C[c + 1] += 1;
-    lc = c;
-  }
-  for (int i = lc + 2; i < 128; i++) {
-    C[i] = C[i - 1];
-  }
-
-  if (!SA) {
-    free(SAp);
-  }
-  return C;
+static int compareInt(const void * a, const void * b) {
+  int x = *(const int *) a;
+  int y = *(const int *) b;
+  return (x > y) - (x < y);
 }
 
-// returns an occurrence table struct for a given string 
-occTable * makeOccTable(char * s, size_t n) {
-  char * alph = sAlph(s, n);
-  int alphn = strlen(alph);
-  occTable * table = malloc(sizeof(occTable) + sizeof(int) * (alphn * n));
-  memset(table, 0, sizeof(occTable) + sizeof(int) * (alphn * n));
-  table->alphn = alphn;
-  table->n = n;
-  memcpy(table->alph, alph, sizeof(char) * alphn);
-  for (int i = 0; i < alphn; i++) {
-    table->map[alph[i]] = i;
-  }
-  for (int i = 0; i < n; i++) {
-    table->data[n * table->map[s[i]] + i]++;
-    if (i == 0) continue;
-    for (int j = 0; j < alphn; j++) {
-      table->data[n * j + i] += table->data[n * j + i - 1];
+// prints every occurrence of q in the suffix array range [st, ed] as a record
+// name and an offset into that record, in text order
+void fmPrintHits(fmIndex * index, char * q, int st, int ed, bool tabular) {
+  int nHits = ed - st + 1;
+  int * hits = malloc(sizeof(int) * nHits);
+  memcpy(hits, index->SA + st, sizeof(int) * nHits);
+  qsort(hits, nHits, sizeof(int), compareInt);
+  recordTable * records = index->records;
+  for (int i = 0; i < nHits; i++) {
+    int r = findRecord(records, hits[i]);
+    int offset = hits[i] - records->start[r];
+    char * name = recordName(records, r);
+    if (tabular) {
+      fprintf(stdout, "%s\t%s\t%d\n", q, name, offset);
+    } else {
+      fprintf(stdout, "%s found in %s at %d\n", q, name, offset);
     }
   }
-  return table;
-}
-
-// gets a character's occurrence given a particular table
-int getOcc(occTable * table, char c, int i) {
-  if (i < 0) return 0;
-  if (i >= table->n) i = table->n - 1;
-  return table->data[table->map[c] * table->n + i];
-}
-
-// The FMsearch algorithm. prints the range of the given pattern q in the string
-// s.
-void range(char * s, char * q, size_t n, size_t m) {
-  int * C = Ctable(s, n, NULL);
-  int * SA = suffixArray(s, n);
-  char * BW = BWtable(s, SA, n);
-  occTable * table = makeOccTable(BW, n);
-  int st = 0;
-  int ed = n - 1;
-  for (int i = m - 1; i >= 0 && st <= ed; i--){
-    char c = q[i];
-    st = C[c] + getOcc(table, c, st - 1);
-    ed = C[c] + getOcc(table, c, ed) - 1;
-#ifdef DEBUG
-    fprintf(stdout, "Step %d: x = %c, st = %d, ed = %d\n", m - i, c, st, ed);
-#endif
-  }
-  fprintf(stdout, "S = %s\n", s);
-  if (st <= ed) {
-    fprintf(stdout, "range(S, %s) = [%d, %d]\n", q, st, ed);
-  } else {
-    fprintf(stdout, "%s not found\n", q);
-  }
-  free(table);
-  free(C);
+  free(hits);
 }
@@ -0,0 +1,442 @@
+/**********************************************************************
+ * on-disk FM-index made of independently built segments              *
+ * fmstore.c                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fmstore.h"
+#include "stats.h"
+
+/**
+ * Helper functions
+ */
+
+// writes one segment: the text, its suffix array, its record table and,
+// over a large alphabet, the wavelet matrix of its BW string, led by its
+// size so it can be skipped
+static void writeSegment(FILE * pFile, char * s, size_t n, int * SA, recordTable * records) {
+  occTable * occ = NULL;
+  if (occNeedsWavelet(s, n)) {
+    uint64_t t0 = statsStart();
+    char * BW = BWtable(s, SA, n);
+    occ = makeOccTable(BW, n, NULL);
+    free(BW);
+    statsStop(PHASE_OCC, t0);
+  }
+  uint64_t t0 = statsStart();
+  uint64_t n64 = n;
+  int32_t nRec = records->n;
+  uint64_t namesLen = records->namesLen;
+  fwrite(&n64, sizeof(uint64_t), 1, pFile);
+  fwrite(s, sizeof(char), n, pFile);
+  fwrite(SA, sizeof(int), n, pFile);
+  fwrite(&nRec, sizeof(int32_t), 1, pFile);
+  fwrite(records->start, sizeof(int), nRec, pFile);
+  fwrite(&namesLen, sizeof(uint64_t), 1, pFile);
+  fwrite(records->names, sizeof(char), namesLen, pFile);
+  uint64_t wmBytes = occ ? waveletBytes(occ->wm) : 0;
+  fwrite(&wmBytes, sizeof(uint64_t), 1, pFile);
+  if (occ) writeWaveletMatrix(pFile, occ->wm);
+  freeOccTable(occ);
+  statsStop(PHASE_WRITE, t0);
+}
+
+// reads one segment at the current file position. If pSA is NULL the suffix
+// array and the wavelet matrix are skipped rather than read. *pwm is NULL if
+// the segment has no wavelet matrix. A segment that is cut short or does not
+// hold together is freed and reported as false.
+static bool readSegment(FILE * pFile, char ** ps, size_t * pn, int ** pSA, waveletMatrix ** pwm, recordTable ** precords) {
+  char * s = NULL;
+  int * SA = NULL;
+  int * start = NULL;
+  char * names = NULL;
+  recordTable * records = NULL;
+  waveletMatrix * wm = NULL;
+
+  uint64_t n64;
+  bool ok = fread(&n64, sizeof(uint64_t), 1, pFile) == 1 && n64 > 0 && n64 <= INT_MAX;
+  size_t n = ok ? n64 : 0;
+  if (ok) {
+    s = malloc(n + 1);
+    ok = s && fread(s, sizeof(char), n, pFile) == n && s[n - 1] == TEXT_END;
+  }
+  for (size_t i = 0; ok && i + 1 < n; i++) {
+    ok = seqSymbol(s[i]) || s[i] == RECORD_SEP;
+  }
+  if (ok && pSA) {
+    SA = malloc(sizeof(int) * n);
+    ok = SA && fread(SA, sizeof(int), n, pFile) == n;
+  } else if (ok) {
+    ok = fseek(pFile, sizeof(int) * n, SEEK_CUR) == 0;
+  }
+
+  int32_t nRec;
+  uint64_t namesLen;
+  ok = ok && fread(&nRec, sizeof(int32_t), 1, pFile) == 1 && nRec > 0 && (size_t) nRec <= n;
+  if (ok) {
+    start = malloc(sizeof(int) * nRec);
+    ok = start && fread(start, sizeof(int), nRec, pFile) == (size_t) nRec;
+  }
+  ok = ok && fread(&namesLen, sizeof(uint64_t), 1, pFile) == 1 && namesLen < SIZE_MAX;
+  if (ok) {
+    names = malloc(namesLen + 1);
+    ok = names && fread(names, sizeof(char), namesLen, pFile) == namesLen;
+  }
+
+  // the names are stored back to back with their terminators, and every
+  // record starts inside the text
+  if (ok) {
+    s[n] = 0;
+    names[namesLen] = 0;
+    records = makeRecordTable();
+    size_t off = 0;
+    for (int32_t i = 0; i < nRec && ok; i++) {
+      size_t m = strlen(names + off);
+      ok = off + m < namesLen && start[i] >= 0 && (size_t) start[i] < n;
+      if (ok) addRecord(records, names + off, m, start[i]);
+      off += m + 1;
+    }
+  }
+  free(start);
+  free(names);
+
+  // the wavelet matrix, if the segment has one
+  uint64_t wmBytes;
+  ok = ok && fread(&wmBytes, sizeof(uint64_t), 1, pFile) == 1;
+  if (ok && wmBytes > 0 && pSA) {
+    wm = readWaveletMatrix(pFile);
+    ok = wm != NULL && wm->n == n;
+  } else if (ok) {
+    ok = wmBytes <= LONG_MAX && fseek(pFile, wmBytes, SEEK_CUR) == 0;
+  }
+  if (!ok) {
+    freeWaveletMatrix(wm);
+    freeRecordTable(records);
+    free(SA);
+    free(s);
+    return false;
+  }
+
+  if (pSA) *pSA = SA;
+  if (pwm) *pwm = wm;
+  *ps = s;
+  *pn = n;
+  *precords = records;
+  return true;
+}
+
+// skips over one segment, returning the length of its text
+static bool skipSegment(FILE * pFile, size_t * pn) {
+  uint64_t n64;
+  int32_t nRec;
+  uint64_t namesLen;
+  uint64_t wmBytes;
+  if (fread(&n64, sizeof(uint64_t), 1, pFile) != 1 || n64 > INT_MAX) return false;
+  if (fseek(pFile, n64 + sizeof(int) * n64, SEEK_CUR) != 0) return false;
+  if (fread(&nRec, sizeof(int32_t), 1, pFile) != 1 || nRec < 0) return false;
+  if (fseek(pFile, sizeof(int) * nRec, SEEK_CUR) != 0) return false;
+  if (fread(&namesLen, sizeof(uint64_t), 1, pFile) != 1 || namesLen > LONG_MAX) return false;
+  if (fseek(pFile, namesLen, SEEK_CUR) != 0) return false;
+  if (fread(&wmBytes, sizeof(uint64_t), 1, pFile) != 1 || wmBytes > LONG_MAX) return false;
+  if (fseek(pFile, wmBytes, SEEK_CUR) != 0) return false;
+  *pn = n64;
+  return true;
+}
+
+// reads and checks the file header, returning the number of segments
+static int readHeader(FILE * pFile) {
+  char magic [4];
+  uint32_t version;
+  uint32_t nSeg;
+  if (fread(magic, sizeof(char), 4, pFile) != 4) return -1;
+  if (memcmp(magic, FMI_MAGIC, 4) != 0) return -1;
+  if (fread(&version, sizeof(uint32_t), 1, pFile) != 1) return -1;
+  if (version != FMI_VERSION) return -1;
+  if (fread(&nSeg, sizeof(uint32_t), 1, pFile) != 1) return -1;
+  return nSeg;
+}
+
+static void writeHeader(FILE * pFile, uint32_t nSeg) {
+  uint32_t version = FMI_VERSION;
+  fseek(pFile, 0L, SEEK_SET);
+  fwrite(FMI_MAGIC, sizeof(char), 4, pFile);
+  fwrite(&version, sizeof(uint32_t), 1, pFile);
+  fwrite(&nSeg, sizeof(uint32_t), 1, pFile);
+}
+
+// opens a new file beside path, with the permissions mode, to be written in
+// its place. Nothing at path changes until replaceFile moves it over.
+static FILE * openTemp(char * path, mode_t mode, char ** ptmp) {
+  size_t m = strlen(path);
+  char * tmp = malloc(m + 8);
+  memcpy(tmp, path, m);
+  memcpy(tmp + m, ".XXXXXX", 8);
+  int fd = mkstemp(tmp);
+  if (fd < 0) {
+    free(tmp);
+    return NULL;
+  }
+  FILE * pFile = fchmod(fd, mode) == 0 ? fdopen(fd, "wb") : NULL;
+  if (pFile == NULL) {
+    close(fd);
+    unlink(tmp);
+    free(tmp);
+    return NULL;
+  }
+  *ptmp = tmp;
+  return pFile;
+}
+
+// closes a file from openTemp and, if all of it reached the disk, renames it
+// over path. Otherwise it is removed and path is left as it was.
+static bool replaceFile(FILE * pFile, char * tmp, char * path, bool ok) {
+  ok = ok && fflush(pFile) == 0 && !ferror(pFile) && fsync(fileno(pFile)) == 0;
+  ok = fclose(pFile) == 0 && ok;
+  ok = ok && rename(tmp, path) == 0;
+  if (!ok) unlink(tmp);
+  free(tmp);
+  return ok;
+}
+
+// copies len bytes from the current position of in to out
+static bool copyBytes(FILE * in, FILE * out, long len) {
+  char buf [1 << 16];
+  while (len > 0) {
+    size_t want = len < (long) sizeof(buf) ? (size_t) len : sizeof(buf);
+    size_t got = fread(buf, sizeof(char), want, in);
+    if (got == 0 || fwrite(buf, sizeof(char), got, out) != got) return false;
+    len -= got;
+  }
+  return true;
+}
+
+// appends the text t and its records to the end of s. s must end in
+// TEXT_END, which becomes the separator between the two.
+static char * joinTexts(char * s, size_t * pn, recordTable * records, char * t, size_t m, recordTable * tRecords) {
+  size_t n = *pn;
+  s = realloc(s, n + m + 1);
+  s[n - 1] = RECORD_SEP;
+  memcpy(s + n, t, m);
+  s[n + m] = 0;
+  for (int i = 0; i < tRecords->n; i++) {
+    char * name = recordName(tRecords, i);
+    addRecord(records, name, strlen(name), tRecords->start[i] + n);
+  }
+  *pn = n + m;
+  return s;
+}
+
+
+/**
+ * primary calls
+ */
+
+// checks the magic number at the front of a file
+bool isIndexFile(char * path) {
+  FILE * pFile = fopen(path, "rb");
+  if (pFile == NULL) return false;
+  char magic [4];
+  bool res = fread(magic, sizeof(char), 4, pFile) == 4 && memcmp(magic, FMI_MAGIC, 4) == 0;
+  fclose(pFile);
+  return res;
+}
+
+// saves a single segment index over s at path. The file is written beside
+// path and renamed over it, so a failed write leaves any old index whole.
+static bool writeSingle(char * path, char * s, size_t n, int * SA, recordTable * records) {
+  mode_t mask = umask(0);
+  umask(mask);
+  char * tmp;
+  FILE * pFile = openTemp(path, 0666 & ~mask, &tmp);
+  bool ok = pFile != NULL;
+  if (ok) {
+    writeHeader(pFile, 1);
+    writeSegment(pFile, s, n, SA, records);
+    ok = replaceFile(pFile, tmp, path, true);
+  }
+  if (!ok) fprintf(stderr, "error writing file at %s\n", path);
+  return ok;
+}
+
+// builds a single segment index over s and saves it at path. Takes ownership
+// of s and the record table.
+bool writeIndexFile(char * path, char * s, size_t n, recordTable * records) {
+  int * SA = suffixArray(s, n);
+  bool ok = writeSingle(path, s, n, SA, records);
+  free(SA);
+  free(s);
+  freeRecordTable(records);
+  return ok;
+}
+
+// saves an index already built in memory at path
+bool writeIndex(char * path, fmIndex * index) {
+  return writeSingle(path, index->s, index->n, index->SA, index->records);
+}
+
+// adds the records of s to a saved index. Only the new text and the trailing
+// segments it is merged with are sorted, and the older segments are copied
+// across as they are. The new index is written beside the old one and renamed
+// over it, so a failed append leaves the old index whole. Takes ownership of
+// s and the record table.
+bool appendIndexFile(char * path, char * s, size_t n, recordTable * records) {
+  FILE * pFile = fopen(path, "rb");
+  int nSeg = pFile ? readHeader(pFile) : -1;
+  if (nSeg < 0) {
+    fprintf(stderr, "error reading index at %s\n", path);
+    if (pFile) fclose(pFile);
+    free(s);
+    freeRecordTable(records);
+    return false;
+  }
+
+  // find where each segment starts, and how long it is
+  long * offsets = malloc(sizeof(long) * (nSeg + 1));
+  size_t * sizes = malloc(sizeof(size_t) * (nSeg + 1));
+  bool ok = true;
+  for (int i = 0; i < nSeg && ok; i++) {
+    offsets[i] = ftell(pFile);
+    ok = skipSegment(pFile, &sizes[i]);
+  }
+  offsets[nSeg] = ftell(pFile);
+  struct stat st;
+  ok = ok && fstat(fileno(pFile), &st) == 0 && offsets[nSeg] <= st.st_size;
+  if (!ok) {
+    fprintf(stderr, "truncated index at %s\n", path);
+    fclose(pFile);
+    free(offsets);
+    free(sizes);
+    free(s);
+    freeRecordTable(records);
+    return false;
+  }
+
+  // walk back over every segment that is no more than twice the size of what
+  // has been gathered so far; those are merged with the new text
+  int k = nSeg;
+  size_t gathered = n;
+  while (k > 0 && gathered * 2 >= sizes[k - 1]) {
+    k--;
+    gathered += sizes[k];
+  }
+
+  char * merged = NULL;
+  size_t nMerged = 0;
+  recordTable * mergedRecords = NULL;
+  if (k < nSeg) {
+    uint64_t t0 = statsStart();
+    fseek(pFile, offsets[k], SEEK_SET);
+    for (int i = k; i < nSeg && ok; i++) {
+      char * t;
+      size_t m;
+      recordTable * tRecords;
+      ok = readSegment(pFile, &t, &m, NULL, NULL, &tRecords);
+      if (ok && merged == NULL) {
+        merged = t;
+        nMerged = m;
+        mergedRecords = tRecords;
+      } else if (ok) {
+        merged = joinTexts(merged, &nMerged, mergedRecords, t, m, tRecords);
+        free(t);
+        freeRecordTable(tRecords);
+      }
+    }
+    if (ok) merged = joinTexts(merged, &nMerged, mergedRecords, s, n, records);
+    free(s);
+    freeRecordTable(records);
+    statsStop(PHASE_LOAD, t0);
+    if (!ok) {
+      fprintf(stderr, "truncated index at %s\n", path);
+      free(merged);
+      freeRecordTable(mergedRecords);
+      fclose(pFile);
+      free(offsets);
+      free(sizes);
+      return false;
+    }
+  } else {
+    merged = s;
+    nMerged = n;
+    mergedRecords = records;
+  }
+
+  // the segments before k are copied and the merged one is written after them
+  int * SA = suffixArray(merged, nMerged);
+  char * tmp;
+  FILE * pOut = openTemp(path, st.st_mode & 07777, &tmp);
+  ok = pOut != NULL;
+  if (ok) {
+    writeHeader(pOut, k + 1);
+    ok = fseek(pFile, offsets[0], SEEK_SET) == 0
+      && copyBytes(pFile, pOut, offsets[k] - offsets[0]);
+    if (ok) writeSegment(pOut, merged, nMerged, SA, mergedRecords);
+    ok = replaceFile(pOut, tmp, path, ok);
+  }
+  if (!ok) fprintf(stderr, "error writing file at %s\n", path);
+  fclose(pFile);
+
+  free(SA);
+  free(merged);
+  freeRecordTable(mergedRecords);
+  free(offsets);
+  free(sizes);
+  return ok;
+}
+
+// loads every segment of a saved index
+fmCollection * readIndexFile(char * path) {
+  FILE * pFile = fopen(path, "rb");
+  int nSeg = pFile ? readHeader(pFile) : -1;
+  if (nSeg < 0) {
+    fprintf(stderr, "error reading index at %s\n", path);
+    if (pFile) fclose(pFile);
+    return NULL;
+  }
+  fmCollection * col = malloc(sizeof(fmCollection));
+  col->nSeg = 0;
+  col->seg = malloc(sizeof(fmIndex *) * (nSeg ? nSeg : 1));
+  for (int i = 0; i < nSeg; i++) {
+    char * s;
+    size_t n;
+    int * SA;
+    waveletMatrix * wm;
+    recordTable * records;
+    uint64_t t0 = statsStart();
+    if (!readSegment(pFile, &s, &n, &SA, &wm, &records)) {
+      fprintf(stderr, "truncated index at %s\n", path);
+      fclose(pFile);
+      freeCollection(col);
+      return NULL;
+    }
+    statsStop(PHASE_LOAD, t0);
+    col->seg[col->nSeg++] = makeFmIndex(s, n, SA, wm, records);
+  }
+  fclose(pFile);
+  return col;
+}
+
+// wraps an index built in memory so it can be searched like a saved one
+fmCollection * singleCollection(fmIndex * index) {
+  fmCollection * col = malloc(sizeof(fmCollection));
+  col->nSeg = 1;
+  col->seg = malloc(sizeof(fmIndex *));
+  col->seg[0] = index;
+  return col;
+}
+
+void freeCollection(fmCollection * col) {
+  if (!col) return;
+  for (int i = 0; i < col->nSeg; i++) {
+    freeFmIndex(col->seg[i]);
+  }
+  free(col->seg);
+  free(col);
+}
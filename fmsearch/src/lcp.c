@@ -0,0 +1,210 @@
+/**********************************************************************
+ * LCP array and repeat queries on the suffix array                   *
+ * lcp.c                                                              *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#include "lcp.h"
+
+#define UNSET   -1
+#define DIVERSE 0
+
+/**
+ * Helper functions
+ */
+
+static bool isSeparator(char c) {
+  return c == RECORD_SEP || c == TEXT_END;
+}
+
+// prints a text position as the record it falls in and its offset there
+static void printPos(fmIndex * index, int pos) {
+  int r = findRecord(index->records, pos);
+  fprintf(stdout, "\t%s\t%d", recordName(index->records, r), pos - index->records->start[r]);
+}
+
+// the character before suffix SA[i], where the start of a record counts as
+// different from every other
+static int leftChar(fmIndex * index, int i) {
+  char c = index->BW[i];
+  return isSeparator(c) ? DIVERSE : c;
+}
+
+// combines the left characters of two sets of suffixes
+static int mergeLeft(int a, int b) {
+  if (a == UNSET) return b;
+  if (b == UNSET) return a;
+  return a == b ? a : DIVERSE;
+}
+
+typedef struct lcpInterval_S {
+  int lcp;
+  int lb;
+  int left;
+} lcpInterval;
+
+
+/**
+ * primary calls
+ */
+
+// builds the LCP array of s with Kasai's algorithm, where LCP[i] is the
+// length of the common prefix of the suffixes SA[i - 1] and SA[i], and
+// LCP[0] is 0. A common prefix ends at a record separator, so no repeat
+// spans two records.
+int * lcpArray(char * s, size_t n, int * SA) {
+  int * rank = malloc(sizeof(int) * n);
+  int * LCP = malloc(sizeof(int) * n);
+  for (int i = 0; i < (int) n; i++) {
+    rank[SA[i]] = i;
+  }
+  // the common prefix of suffix i + 1 and the one before it in the suffix
+  // array is at most one shorter than that of suffix i, so h only ever
+  // drops by one between steps
+  int h = 0;
+  for (int i = 0; i < (int) n; i++) {
+    if (rank[i] == 0) {
+      LCP[0] = 0;
+      h = 0;
+      continue;
+    }
+    int j = SA[rank[i] - 1];
+    while (i + h < (int) n && j + h < (int) n && s[i + h] == s[j + h] && !isSeparator(s[i + h])) {
+      h++;
+    }
+    LCP[rank[i]] = h;
+    if (h > 0) h--;
+  }
+  free(rank);
+  return LCP;
+}
+
+// prints every maximal repeat of at least minLen characters as its length,
+// its number of occurrences, and the position of one occurrence.
+//
+// The LCP intervals are walked bottom up with a stack in one pass. Every
+// interval is a repeat that can't be extended to the right; it is also left
+// maximal if the characters before its suffixes aren't all the same.
+void maximalRepeats(fmIndex * index, int * LCP, int minLen) {
+  int n = index->n;
+  lcpInterval * stack = malloc(sizeof(lcpInterval) * (n + 1));
+  int top = 0;
+  stack[0] = (lcpInterval) { 0, 0, UNSET };
+
+  for (int i = 1; i <= n; i++) {
+    int l = i < n ? LCP[i] : 0;
+    int lb = i - 1;
+    int carry = leftChar(index, i - 1);
+    while (l < stack[top].lcp) {
+      lcpInterval e = stack[top--];
+      e.left = mergeLeft(e.left, carry);
+      if (e.lcp >= minLen && e.left == DIVERSE) {
+        fprintf(stdout, "%d\t%d", e.lcp, i - e.lb);
+        printPos(index, index->SA[e.lb]);
+        fprintf(stdout, "\n");
+      }
+      lb = e.lb;
+      carry = e.left;
+    }
+    if (l > stack[top].lcp) {
+      stack[++top] = (lcpInterval) { l, lb, carry };
+    } else {
+      stack[top].left = mergeLeft(stack[top].left, carry);
+    }
+  }
+  free(stack);
+}
+
+// prints the longest substring that occurs twice, and where
+void longestRepeat(fmIndex * index, int * LCP) {
+  int best = 0;
+  for (int i = 1; i < (int) index->n; i++) {
+    if (LCP[i] > LCP[best]) best = i;
+  }
+  if (best == 0) {
+    fprintf(stdout, "no repeats\n");
+    return;
+  }
+  fprintf(stdout, "%d", LCP[best]);
+  printPos(index, index->SA[best - 1]);
+  printPos(index, index->SA[best]);
+  fprintf(stdout, "\n");
+}
+
+// prints the longest substring shared by the records named a and b. returns
+// false if either record isn't in this index.
+//
+// The longest common prefix of two suffixes is the smallest LCP between
+// them in the suffix array, so it is enough to carry the smallest LCP seen
+// since the last suffix of each record.
+bool longestCommon(fmIndex * index, int * LCP, char * a, char * b) {
+  recordTable * records = index->records;
+  int ra = -1;
+  int rb = -1;
+  for (int r = 0; r < records->n; r++) {
+    if (strcmp(recordName(records, r), a) == 0) ra = r;
+    if (strcmp(recordName(records, r), b) == 0) rb = r;
+  }
+  if (ra < 0 || rb < 0) return false;
+
+  // a record shares all of itself
+  if (ra == rb) {
+    int start = records->start[ra];
+    int end = ra + 1 < records->n ? records->start[ra + 1] - 1 : (int) index->n - 1;
+    if (end == start) {
+      fprintf(stdout, "no common substring\n");
+      return true;
+    }
+    fprintf(stdout, "%d", end - start);
+    printPos(index, start);
+    printPos(index, start);
+    fprintf(stdout, "\n");
+    return true;
+  }
+
+  int sinceA = -1; // smallest LCP since the last suffix of a, or -1
+  int sinceB = -1;
+  int best = 0;
+  int bestA = 0;
+  int bestB = 0;
+  int lastA = 0;
+  int lastB = 0;
+  for (int i = 0; i < (int) index->n; i++) {
+    if (sinceA >= 0 && LCP[i] < sinceA) sinceA = LCP[i];
+    if (sinceB >= 0 && LCP[i] < sinceB) sinceB = LCP[i];
+    int r = findRecord(records, index->SA[i]);
+    if (r == ra) {
+      if (sinceB > best) {
+        best = sinceB;
+        bestA = index->SA[i];
+        bestB = lastB;
+      }
+      sinceA = INT_MAX;
+      lastA = index->SA[i];
+    }
+    if (r == rb) {
+      if (sinceA > best) {
+        best = sinceA;
+        bestA = lastA;
+        bestB = index->SA[i];
+      }
+      sinceB = INT_MAX;
+      lastB = index->SA[i];
+    }
+  }
+  if (best == 0) {
+    fprintf(stdout, "no common substring\n");
+    return true;
+  }
+  fprintf(stdout, "%d", best);
+  printPos(index, bestA);
+  printPos(index, bestB);
+  fprintf(stdout, "\n");
+  return true;
+}
@@ -0,0 +1,11 @@
+/**********************************************************************
+ * stand-alone entry point for fmsearch                               *
+ * main.c                                                             *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include "fmsearch.h"
+
+int main(int argc, char ** argv) {
+  return fmsearchCommand(argc, argv, NULL);
+}
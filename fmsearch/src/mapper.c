@@ -0,0 +1,433 @@
+/**********************************************************************
+ * seed-and-extend read mapping on the FM-index                       *
+ * mapper.c                                                           *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#include "mapper.h"
+#include "stats.h"
+
+#define LEFT    0x4
+#define UPLEFT  0x2
+#define UP      0x1
+
+#define NEG (INT_MIN / 2)
+
+// where one strand of a read aligns
+typedef struct placement_S {
+  fmIndex *        index;
+  int              rec;
+  int              offset;
+  int              score;
+  char *           ops;
+  int              nOps;
+} placement;
+
+/**
+ * Helper functions
+ */
+
+// the end (exclusive) of record r in a segment, which is the position of the
+// separator that closes it
+static int recordEnd(fmIndex * index, int r) {
+  recordTable * records = index->records;
+  return r + 1 < records->n ? records->start[r + 1] - 1 : (int) index->n - 1;
+}
+
+static int compareSeed(const void * a, const void * b) {
+  const seed * x = a;
+  const seed * y = b;
+  if (x->seg != y->seg) return x->seg - y->seg;
+  if (x->t != y->t) return (x->t > y->t) - (x->t < y->t);
+  return x->q - y->q;
+}
+
+// aligns a against b inside the band of diagonals around the line from
+// (0, 0) to (na, nb). If freeEnd is set the alignment may stop anywhere in b,
+// and the number of characters of b it used is written to pnb. The edit
+// operations are written to ops as M (match), X (mismatch), I (a only) and
+// D (b only), and the score is returned. The matrices are taken from the
+// arena.
+static int bandedAlign(
+  char *           a,
+  int              na,
+  char *           b,
+  int              nb,
+  bool             freeEnd,
+  mapParams *      p,
+  char *           ops,
+  int *            pnOps,
+  int *            pnb,
+  dpArena *        arena)
+
+{
+  // the band holds the diagonals lo <= j - i <= hi
+  int lo = (nb < na ? nb - na : 0) - p->band;
+  int hi = (nb > na ? nb - na : 0) + p->band;
+  int w = hi - lo + 1;
+  uint64_t t0 = statsStart();
+  int * V = arenaAlloc(arena, sizeof(int) * (na + 1) * w);
+  char * V_b = arenaAlloc(arena, sizeof(char) * (na + 1) * w);
+
+  for (int i = 0; i <= na; i++) {
+    for (int d = 0; d < w; d++) {
+      int j = i + lo + d;
+      int idx = i * w + d;
+      V[idx] = NEG;
+      V_b[idx] = 0;
+      if (j < 0 || j > nb) continue;
+      if (i == 0 && j == 0) {
+        V[idx] = 0;
+        continue;
+      }
+      if (i > 0 && j > 0) {
+        int ul = V[idx - w] + (a[i - 1] == b[j - 1] ? p->match : p->mismatch);
+        if (ul > V[idx]) {
+          V[idx] = ul;
+          V_b[idx] = UPLEFT;
+        }
+      }
+      if (i > 0 && d + 1 < w) {
+        int u = V[idx - w + 1] + p->indel;
+        if (u > V[idx]) {
+          V[idx] = u;
+          V_b[idx] = UP;
+        }
+      }
+      if (j > 0 && d > 0) {
+        int l = V[idx - 1] + p->indel;
+        if (l > V[idx]) {
+          V[idx] = l;
+          V_b[idx] = LEFT;
+        }
+      }
+    }
+  }
+
+  // pick where the alignment ends in the last row
+  int jEnd = nb;
+  if (freeEnd) {
+    int best = NEG;
+    for (int d = 0; d < w; d++) {
+      int j = na + lo + d;
+      if (j < 0 || j > nb) continue;
+      if (V[na * w + d] > best) {
+        best = V[na * w + d];
+        jEnd = j;
+      }
+    }
+  }
+  int score = V[na * w + jEnd - na - lo];
+  statsStop(PHASE_DP_FILL, t0);
+  statsAdd(COUNT_DP_CELLS, (uint64_t) (na + 1) * w);
+
+  // trace back, writing the operations in reverse
+  t0 = statsStart();
+  int nOps = 0;
+  int i = na;
+  int j = jEnd;
+  while (i > 0 || j > 0) {
+    char dir = V_b[i * w + j - i - lo];
+    if (dir == UPLEFT) {
+      ops[nOps++] = a[i - 1] == b[j - 1] ? 'M' : 'X';
+      i--;
+      j--;
+    } else if (dir == UP) {
+      ops[nOps++] = 'I';
+      i--;
+    } else {
+      ops[nOps++] = 'D';
+      j--;
+    }
+  }
+  for (int k = 0; k < nOps / 2; k++) {
+    char tmp = ops[k];
+    ops[k] = ops[nOps - 1 - k];
+    ops[nOps - 1 - k] = tmp;
+  }
+
+  statsStop(PHASE_TRACEBACK, t0);
+  *pnOps = nOps;
+  if (pnb) *pnb = jEnd;
+  return score;
+}
+
+static void reverse(char * dst, char * src, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = src[n - 1 - i];
+  }
+}
+
+// writes the operations as a CIGAR string, folding matches and mismatches
+// together into M
+static void printCigar(char * ops, int nOps) {
+  int i = 0;
+  while (i < nOps) {
+    char op = ops[i] == 'X' ? 'M' : ops[i];
+    int run = 0;
+    while (i < nOps && (ops[i] == 'X' ? 'M' : ops[i]) == op) {
+      run++;
+      i++;
+    }
+    fprintf(stdout, "%d%c", run, op);
+  }
+}
+
+// aligns one strand of a read along its heaviest seed chain. returns false if
+// it has no chain. The operations are taken from the arena.
+static bool placeStrand(fmCollection * col, char * r, int m, mapParams * p, dpArena * arena, placement * pl) {
+  seed * seeds = NULL;
+  uint64_t t0 = statsStart();
+  int nSeeds = findSmems(col, r, m, p, &seeds);
+  int * chain = malloc(sizeof(int) * (nSeeds ? nSeeds : 1));
+  int nChain = nSeeds ? chainSeeds(col, seeds, nSeeds, p, chain) : 0;
+  statsStop(PHASE_SEARCH, t0);
+  if (nChain == 0) {
+    free(seeds);
+    free(chain);
+    return false;
+  }
+
+  seed * first = &seeds[chain[0]];
+  seed * last = &seeds[chain[nChain - 1]];
+  fmIndex * index = col->seg[first->seg];
+  int rec = findRecord(index->records, first->t);
+  int recStart = index->records->start[rec];
+  int recEnd = recordEnd(index, rec);
+
+  // the reference the read can cover, and room for every operation
+  int headRef = first->q + p->band;
+  if (headRef > first->t - recStart) headRef = first->t - recStart;
+  int tailRef = m - last->q - last->len + p->band;
+  if (tailRef > recEnd - last->t - last->len) tailRef = recEnd - last->t - last->len;
+  int span = last->t + last->len + tailRef - (first->t - headRef);
+  char * ops = arenaAlloc(arena, sizeof(char) * (m + span + 1));
+  char * a = arenaAlloc(arena, sizeof(char) * (m + 1));
+  char * b = arenaAlloc(arena, sizeof(char) * (span + 1));
+  int nOps = 0;
+  int score = 0;
+  int used = 0;
+  int n;
+
+  // extend to the left of the first seed. The strings are reversed so the
+  // alignment is anchored at the seed and free at the far end.
+  reverse(a, r, first->q);
+  reverse(b, index->s + first->t - headRef, headRef);
+  score += bandedAlign(a, first->q, b, headRef, true, p, ops, &n, &used, arena);
+  for (int k = 0; k < n / 2; k++) {
+    char tmp = ops[k];
+    ops[k] = ops[n - 1 - k];
+    ops[n - 1 - k] = tmp;
+  }
+  nOps += n;
+  int offset = first->t - used - recStart;
+
+  // the seeds, and the gaps between them
+  for (int c = 0; c < nChain; c++) {
+    seed * sd = &seeds[chain[c]];
+    if (c > 0) {
+      seed * prev = &seeds[chain[c - 1]];
+      int qg = prev->q + prev->len;
+      int tg = prev->t + prev->len;
+      score += bandedAlign(r + qg, sd->q - qg, index->s + tg, sd->t - tg, false, p, ops + nOps, &n, NULL, arena);
+      nOps += n;
+    }
+    memset(ops + nOps, 'M', sd->len);
+    nOps += sd->len;
+    score += sd->len * p->match;
+  }
+
+  // extend to the right of the last seed
+  int qt = last->q + last->len;
+  score += bandedAlign(r + qt, m - qt, index->s + last->t + last->len, tailRef, true, p, ops + nOps, &n, NULL, arena);
+  nOps += n;
+
+  *pl = (placement) { index, rec, offset, score, ops, nOps };
+  free(seeds);
+  free(chain);
+  return true;
+}
+
+// aligns both strands of one read and prints the better placement, the
+// forward strand on a tie. The arena is reset for each read. A read holding
+// a byte no record can hold is reported unmapped without being seeded.
+static void mapRead(fmCollection * col, char * name, char * r, int m, mapParams * p, dpArena * arena) {
+  for (int i = 0; i < m; i++) {
+    if (!seqSymbol(r[i])) {
+      fprintf(stderr, "unsupported character %d in read %s\n", (unsigned char) r[i], name);
+      fprintf(stdout, "%s\t*\t-1\t*\t0\t*\n", name);
+      statsAdd(COUNT_QUERIES, 1);
+      return;
+    }
+  }
+
+  arenaReset(arena);
+  placement fwd;
+  placement rev;
+  bool onFwd = placeStrand(col, r, m, p, arena, &fwd);
+  char * rc = arenaAlloc(arena, m + 1);
+  reverseComplement(rc, r, m);
+  bool onRev = placeStrand(col, rc, m, p, arena, &rev);
+  statsAdd(COUNT_QUERIES, 1);
+  if (!onFwd && !onRev) {
+    fprintf(stdout, "%s\t*\t-1\t*\t0\t*\n", name);
+    return;
+  }
+
+  placement * pl = onFwd && (!onRev || fwd.score >= rev.score) ? &fwd : &rev;
+  fprintf(stdout, "%s\t%s\t%d\t%c\t%d\t", name, recordName(pl->index->records, pl->rec), pl->offset,
+    pl == &fwd ? '+' : '-', pl->score);
+  printCigar(pl->ops, pl->nOps);
+  fprintf(stdout, "\n");
+}
+
+
+/**
+ * primary calls
+ */
+
+// finds the super-maximal exact matches of r[0, m) in every segment and
+// returns one seed per occurrence.
+//
+// For each end position e, the backward search from e is run until it fails,
+// giving the longest match [b(e), e]. b never increases as e decreases, and
+// [b(e), e] is contained in [b(e + 1), e + 1] exactly when the two starts
+// are equal, so the SMEMs are the matches whose start differs from the one
+// before. Once a match reaches the start of the read every later one is
+// contained in it.
+//
+// Each end position costs one backward step per segment for every character
+// of its longest match, so a read takes O(m * L) steps per segment, where L
+// is its longest match that doesn't reach the start of the read: O(m^2) at
+// worst. The forward and backward scan that finds SMEMs in O(m) steps needs
+// a bidirectional index, which fmsearch doesn't build.
+int findSmems(fmCollection * col, char * r, int m, mapParams * p, seed ** pseeds) {
+  int nSeg = col->nSeg;
+  int * st = malloc(sizeof(int) * nSeg);
+  int * ed = malloc(sizeof(int) * nSeg);
+  int * bst = malloc(sizeof(int) * nSeg);
+  int * bed = malloc(sizeof(int) * nSeg);
+  int cap = 16;
+  int nSeeds = 0;
+  seed * seeds = malloc(sizeof(seed) * cap);
+  uint64_t steps = 0;
+
+  int prevB = -1;
+  for (int e = m - 1; e >= 0; e--) {
+    for (int k = 0; k < nSeg; k++) {
+      st[k] = 0;
+      ed[k] = col->seg[k]->n - 1;
+    }
+    int b = e + 1;
+    for (int i = e; i >= 0; i--) {
+      bool any = false;
+      for (int k = 0; k < nSeg; k++) {
+        if (st[k] > ed[k]) continue;
+        any |= backwardStep(col->seg[k], r[i], &st[k], &ed[k]);
+        steps++;
+      }
+      if (!any) break;
+      b = i;
+      memcpy(bst, st, sizeof(int) * nSeg);
+      memcpy(bed, ed, sizeof(int) * nSeg);
+    }
+
+    int len = e - b + 1;
+    if (b != prevB && len >= p->minSeed) {
+      int nOcc = 0;
+      for (int k = 0; k < nSeg; k++) {
+        if (bst[k] <= bed[k]) nOcc += bed[k] - bst[k] + 1;
+      }
+      for (int k = 0; k < nSeg && nOcc <= p->maxOcc; k++) {
+        for (int j = bst[k]; j <= bed[k]; j++) {
+          if (nSeeds == cap) {
+            cap *= 2;
+            seeds = realloc(seeds, sizeof(seed) * cap);
+          }
+          seeds[nSeeds++] = (seed) { b, col->seg[k]->SA[j], len, k };
+        }
+      }
+    }
+    prevB = b;
+    if (b == 0) break;
+  }
+
+  statsAdd(COUNT_BACKWARD_STEPS, steps);
+  free(st);
+  free(ed);
+  free(bst);
+  free(bed);
+  *pseeds = seeds;
+  return nSeeds;
+}
+
+// finds the heaviest chain of collinear seeds in one record, where a seed may
+// follow another if it starts after it in both the read and the text and its
+// diagonal is within the band. The seeds are sorted by position, and the
+// indices of the chain are written to chain in order. returns its length.
+//
+// Each seed is only tried against the p->lookback seeds before it, so n
+// seeds take O(n log n + n * lookback) rather than O(n^2). A chain is only
+// cut short when more than lookback seeds sort between two of its seeds, as
+// over a heavily repeated stretch of the text.
+int chainSeeds(fmCollection * col, seed * seeds, int nSeeds, mapParams * p, int * chain) {
+  qsort(seeds, nSeeds, sizeof(seed), compareSeed);
+  int * score = malloc(sizeof(int) * nSeeds);
+  int * prev = malloc(sizeof(int) * nSeeds);
+  int * rec = malloc(sizeof(int) * nSeeds);
+  int best = 0;
+
+  for (int i = 0; i < nSeeds; i++) {
+    rec[i] = findRecord(col->seg[seeds[i].seg]->records, seeds[i].t);
+    score[i] = seeds[i].len;
+    prev[i] = -1;
+    int diag = seeds[i].t - seeds[i].q;
+    for (int j = i - 1; j >= 0 && j >= i - p->lookback; j--) {
+      if (seeds[j].seg != seeds[i].seg || rec[j] != rec[i]) break;
+      if (seeds[j].q + seeds[j].len > seeds[i].q) continue;
+      if (seeds[j].t + seeds[j].len > seeds[i].t) continue;
+      int gap = diag - (seeds[j].t - seeds[j].q);
+      if (gap > p->band || gap < -p->band) continue;
+      if (score[j] + seeds[i].len > score[i]) {
+        score[i] = score[j] + seeds[i].len;
+        prev[i] = j;
+      }
+    }
+    if (score[i] > score[best]) best = i;
+  }
+
+  int n = 0;
+  for (int i = best; i >= 0; i = prev[i]) {
+    chain[n++] = i;
+  }
+  for (int k = 0; k < n / 2; k++) {
+    int tmp = chain[k];
+    chain[k] = chain[n - 1 - k];
+    chain[n - 1 - k] = tmp;
+  }
+
+  free(score);
+  free(prev);
+  free(rec);
+  return n;
+}
+
+// maps every read of a FASTA or FASTQ file against the index, one record at a
+// time as it is read. Each read is printed as its name, the record and offset
+// it aligns to, its strand (+ or -, where - is the reverse complement of the
+// read), the alignment score and a CIGAR string of the read on that strand.
+bool mapReads(fmCollection * col, seqReader * reads, mapParams * p) {
+  dpArena arena = { NULL, 0, 0 };
+  seqRecord rec;
+  while (nextSeq(reads, &rec)) {
+    mapRead(col, rec.name, rec.seq, rec.len, p, &arena);
+  }
+  freeArena(&arena);
+  return !reads->failed;
+}
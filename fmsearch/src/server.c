@@ -0,0 +1,470 @@
+/**********************************************************************
+ * FM-index query server and client over a Unix domain socket         *
+ * server.c                                                           *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "stats.h"
+
+// one connected client, whatever it has sent past its last full line, and
+// the replies its socket has not yet taken, from out + outPos to out + outLen
+typedef struct client_S {
+  int fd;
+  char * buf;
+  size_t len;
+  size_t cap;
+  char * out;
+  size_t outPos;
+  size_t outLen;
+  size_t outCap;
+  bool eof;    // the client has sent everything it will
+  bool dead;   // the connection failed, so it is dropped
+} client;
+
+// a request line taken from a client, and the reply made for it
+typedef struct request_S {
+  uint32_t client;
+  char * line;
+  char * reply;
+  size_t replyLen;
+} request;
+
+// a fixed set of threads that answers each batch of requests together
+typedef struct workerPool_S {
+  fmCollection *   col;
+  request *        batch;
+  uint32_t         nBatch;
+  atomic_uint      next;
+  uint32_t         nThreads;
+  uint32_t         running;    // threads still working on the batch
+  uint64_t         generation; // counts the batches handed out
+  bool             stop;
+  pthread_mutex_t  lock;
+  pthread_cond_t   start;
+  pthread_cond_t   done;
+  pthread_t *      threads;
+} workerPool;
+
+#define READ_BLOCK (1 << 16) // bytes read from a client at a time
+#define OUT_LIMIT  (1 << 20) // unsent reply bytes before a client is read no further
+
+static volatile sig_atomic_t stopping = 0;
+
+/**
+ * Helper functions
+ */
+
+static void onSignal(int sig) {
+  (void) sig;
+  stopping = 1;
+}
+
+static int compareInt(const void * a, const void * b) {
+  int x = *(const int *) a;
+  int y = *(const int *) b;
+  return (x > y) - (x < y);
+}
+
+// appends to a reply, growing it as needed
+static void appendf(request * req, size_t * pCap, const char * fmt, ...) {
+  va_list args;
+  for (;;) {
+    va_start(args, fmt);
+    int k = vsnprintf(req->reply + req->replyLen, *pCap - req->replyLen, fmt, args);
+    va_end(args);
+    if (req->replyLen + k < *pCap) {
+      req->replyLen += k;
+      return;
+    }
+    *pCap = 2 * (*pCap + k);
+    req->reply = realloc(req->reply, *pCap);
+  }
+}
+
+// answers one request in every segment of the index
+static void answer(fmCollection * col, request * req) {
+  size_t cap = 64;
+  req->reply = malloc(cap);
+  req->replyLen = 0;
+  char * op = req->line;
+  char * q = strchr(op, ' ');
+  if (q == NULL || q[1] == 0) {
+    appendf(req, &cap, "error expected an operation and a pattern\n");
+    return;
+  }
+  *q++ = 0;
+  size_t m = strlen(q);
+  bool count = strcmp(op, "count") == 0;
+  bool ranges = strcmp(op, "range") == 0;
+  bool locate = strcmp(op, "locate") == 0;
+  if (!count && !ranges && !locate) {
+    appendf(req, &cap, "error unknown operation %s\n", op);
+    return;
+  }
+
+  uint64_t t0 = statsStart();
+  long long total = 0;
+  char * sep = "";
+  for (int k = 0; k < col->nSeg; k++) {
+    fmIndex * index = col->seg[k];
+    int st, ed;
+    if (!fmRange(index, q, m, &st, &ed)) continue;
+    total += ed - st + 1;
+    if (ranges) {
+      appendf(req, &cap, "%s%d:%d-%d", sep, k, st, ed);
+      sep = " ";
+    } else if (locate) {
+      int nHits = ed - st + 1;
+      int * hits = malloc(sizeof(int) * nHits);
+      memcpy(hits, index->SA + st, sizeof(int) * nHits);
+      qsort(hits, nHits, sizeof(int), compareInt);
+      for (int i = 0; i < nHits; i++) {
+        int r = findRecord(index->records, hits[i]);
+        appendf(req, &cap, "%s%s:%d", sep, recordName(index->records, r), hits[i] - index->records->start[r]);
+        sep = " ";
+      }
+      free(hits);
+    }
+  }
+  if (count) appendf(req, &cap, "%lld", total);
+  appendf(req, &cap, "\n");
+  statsStop(PHASE_SEARCH, t0);
+  statsAdd(COUNT_QUERIES, 1);
+}
+
+static void * batchWorker(void * arg) {
+  workerPool * pool = arg;
+  uint64_t seen = 0;
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->generation == seen && !pool->stop) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    if (pool->stop) break;
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+    uint32_t k;
+    while ((k = atomic_fetch_add(&pool->next, 1)) < pool->nBatch) {
+      answer(pool->col, &pool->batch[k]);
+    }
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0) pthread_cond_signal(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+// answers every request of the batch. A lone request is answered here,
+// since waking the pool would cost more than the lookup.
+static void runBatch(workerPool * pool, request * batch, uint32_t n) {
+  if (n == 1) {
+    answer(pool->col, &batch[0]);
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->batch = batch;
+  pool->nBatch = n;
+  atomic_store(&pool->next, 0);
+  pool->running = pool->nThreads;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  while (pool->running > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// moves the full lines a client has sent into the batch, up to its limit.
+// Returns true if full lines are left over for the next batch.
+static bool takeLines(client * c, uint32_t ci, request * batch, uint32_t * pn) {
+  if (c->len == 0) return false;
+  size_t pos = 0;
+  char * end;
+  while (*pn < SERVER_BATCH && (end = memchr(c->buf + pos, '\n', c->len - pos)) != NULL) {
+    size_t k = end - (c->buf + pos);
+    if (k > 0 && c->buf[pos + k - 1] == '\r') k--;
+    batch[*pn] = (request) { ci, strndup(c->buf + pos, k), NULL, 0 };
+    (*pn)++;
+    pos = end - c->buf + 1;
+  }
+  memmove(c->buf, c->buf + pos, c->len - pos);
+  c->len -= pos;
+  return memchr(c->buf, '\n', c->len) != NULL;
+}
+
+// reads whatever a client has ready. A line too long to be a request drops
+// the client.
+static void readClient(client * c) {
+  if (c->cap - c->len < READ_BLOCK) {
+    c->cap = c->len + READ_BLOCK;
+    c->buf = realloc(c->buf, c->cap);
+  }
+  ssize_t k = read(c->fd, c->buf + c->len, c->cap - c->len);
+  if (k < 0 && errno != EINTR && errno != EAGAIN) c->dead = true;
+  if (k == 0) c->eof = true;
+  if (k > 0) c->len += k;
+  if (c->len > SERVER_MAX_LINE && memchr(c->buf, '\n', c->len) == NULL) c->dead = true;
+}
+
+// adds a reply to those waiting to be sent to a client
+static void queueReply(client * c, char * s, size_t n) {
+  if (c->outLen + n > c->outCap && c->outPos > 0) {
+    memmove(c->out, c->out + c->outPos, c->outLen - c->outPos);
+    c->outLen -= c->outPos;
+    c->outPos = 0;
+  }
+  if (c->outLen + n > c->outCap) {
+    c->outCap = 2 * (c->outLen + n);
+    c->out = realloc(c->out, c->outCap);
+  }
+  memcpy(c->out + c->outLen, s, n);
+  c->outLen += n;
+}
+
+// sends as much of a client's waiting replies as its socket takes without
+// blocking
+static void flushClient(client * c) {
+  while (c->outPos < c->outLen) {
+    ssize_t k = send(c->fd, c->out + c->outPos, c->outLen - c->outPos, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR) continue;
+    if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (k <= 0) {
+      c->dead = true;
+      return;
+    }
+    c->outPos += k;
+  }
+  c->outPos = 0;
+  c->outLen = 0;
+}
+
+static bool writeAll(int fd, char * s, size_t n) {
+  while (n > 0) {
+    ssize_t k = send(fd, s, n, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR) continue;
+    if (k <= 0) return false;
+    s += k;
+    n -= k;
+  }
+  return true;
+}
+
+// a listening socket at path. A stale socket left there is replaced, but
+// any other kind of file is not.
+static int listenAt(char * path) {
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "socket path too long: %s\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+  struct stat st;
+  if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+    fprintf(stderr, "error listening at %s\n", path);
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+
+/**
+ * primary calls
+ */
+
+// answers requests on a socket at path until SIGINT or SIGTERM. One thread
+// waits on every connection, and each time some are ready it takes all the
+// full request lines waiting on them, up to SERVER_BATCH, as one batch. The
+// batch is answered across a fixed pool of nThreads threads and the replies
+// queued on their clients in order. Client sockets never block: a reply a
+// client is slow to take waits until its socket is writable, and a client
+// with OUT_LIMIT bytes waiting is not read from until they are sent.
+bool serveIndex(fmCollection * col, char * path, int nThreads) {
+  int lfd = listenAt(path);
+  if (lfd < 0) return false;
+
+  struct sigaction sa = { 0 };
+  sa.sa_handler = onSignal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  workerPool pool = { .col = col };
+  pool.nThreads = nThreads > 0 ? nThreads : 1;
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.start, NULL);
+  pthread_cond_init(&pool.done, NULL);
+  pool.threads = malloc(sizeof(pthread_t) * pool.nThreads);
+  for (uint32_t i = 0; i < pool.nThreads; i++) {
+    pthread_create(&pool.threads[i], NULL, batchWorker, &pool);
+  }
+
+  uint32_t capClients = 16;
+  uint32_t nClients = 0;
+  client * clients = malloc(sizeof(client) * capClients);
+  struct pollfd * fds = malloc(sizeof(struct pollfd) * (capClients + 1));
+  request * batch = malloc(sizeof(request) * SERVER_BATCH);
+  bool pending = false; // some client has full lines left from the last batch
+
+  fprintf(stdout, "serving %d segments at %s\n", col->nSeg, path);
+  fflush(stdout);
+  while (!stopping) {
+    fds[0] = (struct pollfd) { lfd, POLLIN, 0 };
+    for (uint32_t i = 0; i < nClients; i++) {
+      client * c = &clients[i];
+      size_t unsent = c->outLen - c->outPos;
+      short events = (c->eof || unsent >= OUT_LIMIT ? 0 : POLLIN) | (unsent > 0 ? POLLOUT : 0);
+      fds[i + 1] = (struct pollfd) { c->fd, events, 0 };
+    }
+    if (poll(fds, nClients + 1, pending ? 0 : -1) < 0) continue;
+
+    // gather everything that is ready into one batch
+    uint32_t n = 0;
+    pending = false;
+    for (uint32_t i = 0; i < nClients; i++) {
+      client * c = &clients[i];
+      if (fds[i + 1].revents & POLLOUT) flushClient(c);
+      if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) readClient(c);
+      if (!c->dead && c->outLen - c->outPos < OUT_LIMIT) pending |= takeLines(c, i, batch, &n);
+    }
+    if (n > 0) runBatch(&pool, batch, n);
+    for (uint32_t k = 0; k < n; k++) {
+      client * c = &clients[batch[k].client];
+      if (!c->dead) queueReply(c, batch[k].reply, batch[k].replyLen);
+      free(batch[k].line);
+      free(batch[k].reply);
+    }
+    for (uint32_t i = 0; i < nClients; i++) {
+      if (!clients[i].dead) flushClient(&clients[i]);
+    }
+
+    // drop the clients that are finished, and take on new ones
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < nClients; i++) {
+      client * c = &clients[i];
+      bool finished = c->eof && c->outPos == c->outLen && (c->len == 0 || memchr(c->buf, '\n', c->len) == NULL);
+      if (c->dead || finished) {
+        close(c->fd);
+        free(c->buf);
+        free(c->out);
+      } else {
+        clients[kept++] = *c;
+      }
+    }
+    nClients = kept;
+    int fd;
+    while ((fds[0].revents & POLLIN) && (fd = accept(lfd, NULL, NULL)) >= 0) {
+      if (nClients == capClients) {
+        capClients *= 2;
+        clients = realloc(clients, sizeof(client) * capClients);
+        fds = realloc(fds, sizeof(struct pollfd) * (capClients + 1));
+      }
+      fcntl(fd, F_SETFL, O_NONBLOCK);
+      clients[nClients++] = (client) { .fd = fd };
+    }
+  }
+
+  pthread_mutex_lock(&pool.lock);
+  pool.stop = true;
+  pthread_cond_broadcast(&pool.start);
+  pthread_mutex_unlock(&pool.lock);
+  for (uint32_t i = 0; i < pool.nThreads; i++) {
+    pthread_join(pool.threads[i], NULL);
+  }
+  for (uint32_t i = 0; i < nClients; i++) {
+    close(clients[i].fd);
+    free(clients[i].buf);
+    free(clients[i].out);
+  }
+  free(pool.threads);
+  free(clients);
+  free(fds);
+  free(batch);
+  close(lfd);
+  unlink(path);
+  return true;
+}
+
+// sends requests to the server at path and prints each reply. The request
+// is the arguments joined by spaces, or with no arguments every line of
+// stdin, sent CLIENT_WINDOW at a time ahead of their replies.
+bool queryServer(char * path, int nArgs, char ** args) {
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "socket path too long: %s\n", path);
+    return false;
+  }
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    fprintf(stderr, "error connecting to %s\n", path);
+    if (fd >= 0) close(fd);
+    return false;
+  }
+  FILE * replies = fdopen(dup(fd), "r");
+  char * line = NULL;
+  size_t lineCap = 0;
+  bool ok = true;
+
+  if (nArgs > 0) {
+    for (int i = 0; i < nArgs && ok; i++) {
+      ok = writeAll(fd, args[i], strlen(args[i])) && writeAll(fd, i + 1 < nArgs ? " " : "\n", 1);
+    }
+    if (ok && getline(&line, &lineCap, replies) > 0) {
+      fputs(line, stdout);
+    } else {
+      ok = false;
+    }
+  } else {
+    ssize_t k;
+    int inFlight = 0;
+    bool more = true;
+    while (ok && (more || inFlight > 0)) {
+      if (more && inFlight < CLIENT_WINDOW && (k = getline(&line, &lineCap, stdin)) > 0) {
+        if (line[k - 1] != '\n') {
+          lineCap = k + 2;
+          line = realloc(line, lineCap);
+          line[k++] = '\n';
+        }
+        ok = writeAll(fd, line, k);
+        inFlight++;
+        continue;
+      }
+      if (more && inFlight < CLIENT_WINDOW) {
+        more = false;
+        shutdown(fd, SHUT_WR);
+      }
+      if (inFlight == 0) break;
+      if (getline(&line, &lineCap, replies) <= 0) {
+        ok = false;
+        break;
+      }
+      fputs(line, stdout);
+      inFlight--;
+    }
+  }
+  if (!ok) fprintf(stderr, "lost the connection to %s\n", path);
+  free(line);
+  fclose(replies);
+  close(fd);
+  return ok;
+}
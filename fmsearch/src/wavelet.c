@@ -0,0 +1,160 @@
+/**********************************************************************
+ * wavelet matrix for rank queries over large alphabets               *
+ * wavelet.c                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wavelet.h"
+
+/**
+ * Helper functions
+ */
+
+// counts the 1 bits before position p on a level
+static size_t rank1(waveletMatrix * wm, int level, size_t p) {
+  uint64_t * bits = wm->bits + level * wm->nWords;
+  size_t block = p / (64 * WM_BLOCK_WORDS);
+  size_t count = wm->blocks[level * wm->nBlocks + block];
+  size_t word = block * WM_BLOCK_WORDS;
+  for (; word < p / 64; word++) {
+    count += __builtin_popcountll(bits[word]);
+  }
+  if (p % 64) count += __builtin_popcountll(bits[word] & ((1ULL << (p % 64)) - 1));
+  return count;
+}
+
+
+/**
+ * primary calls
+ */
+
+// builds the wavelet matrix of s, where map gives the code of each character
+// and alphn is the number of codes
+waveletMatrix * makeWaveletMatrix(char * s, size_t n, int * map, int alphn) {
+  waveletMatrix * wm = malloc(sizeof(waveletMatrix));
+  wm->levels = 1;
+  while ((1 << wm->levels) < alphn) wm->levels++;
+  wm->n = n;
+  wm->nWords = n / 64 + 1;
+  wm->nBlocks = wm->nWords / WM_BLOCK_WORDS + 1;
+  wm->bits = calloc(wm->levels * wm->nWords, sizeof(uint64_t));
+  wm->blocks = malloc(sizeof(uint32_t) * wm->levels * wm->nBlocks);
+
+  // the codes in the order of the current level, and the next
+  uint8_t * cur = malloc(n);
+  uint8_t * next = malloc(n);
+  for (size_t i = 0; i < n; i++) {
+    cur[i] = map[(unsigned char) s[i]];
+  }
+
+  for (int l = 0; l < wm->levels; l++) {
+    int shift = wm->levels - 1 - l;
+    uint64_t * bits = wm->bits + l * wm->nWords;
+    size_t zeros = 0;
+    for (size_t i = 0; i < n; i++) {
+      if ((cur[i] >> shift) & 1) bits[i / 64] |= 1ULL << (i % 64);
+      else zeros++;
+    }
+    wm->zeros[l] = zeros;
+
+    uint32_t * blocks = wm->blocks + l * wm->nBlocks;
+    uint32_t count = 0;
+    for (size_t w = 0; w < wm->nWords; w++) {
+      if (w % WM_BLOCK_WORDS == 0) blocks[w / WM_BLOCK_WORDS] = count;
+      count += __builtin_popcountll(bits[w]);
+    }
+
+    // stable partition by the bit: zeros first, then ones
+    size_t z = 0;
+    size_t o = zeros;
+    for (size_t i = 0; i < n; i++) {
+      if ((cur[i] >> shift) & 1) next[o++] = cur[i];
+      else next[z++] = cur[i];
+    }
+    uint8_t * tmp = cur;
+    cur = next;
+    next = tmp;
+  }
+
+  free(cur);
+  free(next);
+  return wm;
+}
+
+// counts the occurrences of the symbol code in s[0, i)
+size_t waveletRank(waveletMatrix * wm, int code, size_t i) {
+  size_t st = 0;
+  size_t ed = i;
+  for (int l = 0; l < wm->levels; l++) {
+    if ((code >> (wm->levels - 1 - l)) & 1) {
+      st = wm->zeros[l] + rank1(wm, l, st);
+      ed = wm->zeros[l] + rank1(wm, l, ed);
+    } else {
+      st = st - rank1(wm, l, st);
+      ed = ed - rank1(wm, l, ed);
+    }
+  }
+  return ed - st;
+}
+
+// the size of wm as writeWaveletMatrix writes it
+uint64_t waveletBytes(waveletMatrix * wm) {
+  return sizeof(int32_t) + sizeof(uint64_t) * (3 + 8) +
+    sizeof(uint64_t) * wm->levels * wm->nWords + sizeof(uint32_t) * wm->levels * wm->nBlocks;
+}
+
+bool writeWaveletMatrix(FILE * pFile, waveletMatrix * wm) {
+  int32_t levels = wm->levels;
+  uint64_t sizes [3] = { wm->n, wm->nWords, wm->nBlocks };
+  uint64_t zeros [8];
+  for (int l = 0; l < 8; l++) {
+    zeros[l] = wm->zeros[l];
+  }
+  return fwrite(&levels, sizeof(int32_t), 1, pFile) == 1 &&
+    fwrite(sizes, sizeof(uint64_t), 3, pFile) == 3 &&
+    fwrite(zeros, sizeof(uint64_t), 8, pFile) == 8 &&
+    fwrite(wm->bits, sizeof(uint64_t), levels * wm->nWords, pFile) == levels * wm->nWords &&
+    fwrite(wm->blocks, sizeof(uint32_t), levels * wm->nBlocks, pFile) == levels * wm->nBlocks;
+}
+
+// reads a matrix written by writeWaveletMatrix, or returns NULL if the file
+// is short or the sizes don't fit together
+waveletMatrix * readWaveletMatrix(FILE * pFile) {
+  int32_t levels;
+  uint64_t sizes [3];
+  uint64_t zeros [8];
+  if (fread(&levels, sizeof(int32_t), 1, pFile) != 1) return NULL;
+  if (fread(sizes, sizeof(uint64_t), 3, pFile) != 3) return NULL;
+  if (fread(zeros, sizeof(uint64_t), 8, pFile) != 8) return NULL;
+  if (levels < 1 || levels > 8) return NULL;
+  if (sizes[1] != sizes[0] / 64 + 1 || sizes[2] != sizes[1] / WM_BLOCK_WORDS + 1) return NULL;
+
+  waveletMatrix * wm = malloc(sizeof(waveletMatrix));
+  wm->levels = levels;
+  wm->n = sizes[0];
+  wm->nWords = sizes[1];
+  wm->nBlocks = sizes[2];
+  for (int l = 0; l < 8; l++) {
+    wm->zeros[l] = zeros[l];
+  }
+  wm->bits = malloc(sizeof(uint64_t) * levels * wm->nWords);
+  wm->blocks = malloc(sizeof(uint32_t) * levels * wm->nBlocks);
+  if (fread(wm->bits, sizeof(uint64_t), levels * wm->nWords, pFile) != levels * wm->nWords ||
+      fread(wm->blocks, sizeof(uint32_t), levels * wm->nBlocks, pFile) != levels * wm->nBlocks) {
+    freeWaveletMatrix(wm);
+    return NULL;
+  }
+  return wm;
+}
+
+void freeWaveletMatrix(waveletMatrix * wm) {
+  if (!wm) return;
+  free(wm->bits);
+  free(wm->blocks);
+  free(wm);
+}
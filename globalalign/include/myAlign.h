@@ -0,0 +1,15 @@
+/**********************************************************************
+ * global alignment of the first two records of a file                *
+ * myAlign.h                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef MYALIGN_H
+#define MYALIGN_H
+
+#include "align.h"
+#include "context.h"
+
+int myAlignCommand(int, char **, chainContext *);
+
+#endif
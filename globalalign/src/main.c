@@ -0,0 +1,11 @@
+/**********************************************************************
+ * stand-alone entry point for myAlign                                *
+ * main.c                                                             *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include "myAlign.h"
+
+int main(int argc, char ** argv) {
+  return myAlignCommand(argc, argv, NULL);
+}
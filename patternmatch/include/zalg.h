@@ -0,0 +1,19 @@
+/**********************************************************************
+ * Z-algorithm pattern matching                                       *
+ * zalg.h                                                             *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#ifndef ZALG_H
+#define ZALG_H
+
+#include <stddef.h>
+
+#include "packdna.h"
+#include "context.h"
+
+size_t zalg_pattern_match(char *, char *);
+size_t zalg_packed_match(packedSeq *, packedSeq *);
+int zalgCommand(int, char **, chainContext *);
+
+#endif
@@ -0,0 +1,11 @@
+/**********************************************************************
+ * stand-alone entry point for zalg                                   *
+ * main.c                                                             *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include "zalg.h"
+
+int main(int argc, char ** argv) {
+  return zalgCommand(argc, argv, NULL);
+}
@@ -8,52 +8,72 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
-size_t z_pattern_match(char * p, char * t);
+#include "seqio.h"
+#include "stats.h"
+#include "zalg.h"
 
-int main(int argc, char ** argv) {
-  // early return if the arguments aren't formatted correctly
-  if (argc < 3 || argc > 3) return 0;
+// zalg pattern file: finds the first match of pattern in the records of the
+// file joined together. ctx holds the inputs of a chain, or is NULL.
+int zalgCommand(int argc, char ** argv, chainContext * ctx) {
+  argc = statsOption(argc, argv);
 
-  char * p = argv[1]; // the pattern string
-  char * t = NULL;   // the text string
-  FILE * pFile = fopen(argv[2], "r"); // pointer to the given file
-  if (pFile == NULL) {
-    fprintf(stderr, "error reading file at %s\n", argv[2]);
+  // early return if the arguments aren't formatted correctly
+  if (argc != 3) {
+    fprintf(stdout, "expected two arguments: a pattern and a filepath\n");
     return 1;
   }
-  
-
-  fseek(pFile, 0L, SEEK_END);
-  size_t fsize = ftell(pFile); // the size of the file
-  fseek(pFile, 0L, SEEK_SET);
 
-  // We will now read the file into the text string
-  t = malloc(fsize);
-  char * next = t; // pointer to the next position in the string to read the file line into
-
-  while (!feof(pFile)) {
-    // the upper bound to read characters into the text string
-    size_t n = fsize - (next - t); 
-
-    // read the next file line into the text string at 'next'
-    getline(&next, &n, pFile); 
-
-    // find the next instance of \n, \r, >, or ';', and set that to next
-    // This will have the effect of overwriting the string starting at any
-    // of these characters. This will erase comments, and will remove the 
-    // carriage returns or newline characters.
-    next = strpbrk(next, "\n\r>;");
+  char * p = argv[1]; // the pattern string
+  uint64_t t0 = statsStart();
+  seqSet * set = loadSeqSet(ctx, argv[2]);
+  if (set == NULL) return 1;
+
+  // the text string is every record's sequence joined together. Records in
+  // the map are in file order, so they are moved down over the headers in
+  // place; records read from a gzip file, or shared with the rest of a
+  // chain, are copied.
+  bool copied = set->n == 0 || ctx || (set->reader->map == NULL && set->n != 1);
+  char * t = NULL;
+  if (!copied) {
+    t = set->rec[0].seq;
+  } else {
+    size_t total = 0;
+    for (size_t i = 0; i < set->n; i++) total += set->rec[i].len;
+    t = malloc(total + 1);
   }
-  
-  // sets the final newline/carriage return to 0 if it exists.
-  if (next) next[0] = 0;
+  size_t b_l = 0; // the length of the text string
+  for (size_t i = 0; i < set->n; i++) {
+    memmove(t + b_l, set->rec[i].seq, set->rec[i].len);
+    b_l += set->rec[i].len;
+  }
+  t[b_l] = 0;
+  statsStop(PHASE_LOAD, t0);
 
-  size_t index = z_pattern_match(p, t);
+  // nucleotide strings are matched in their packed form, where the pattern
+  // is extended along the text 32 bases at a time
+  size_t a_l = strlen(p);
+  size_t index;
+  if (worthPacking(p, a_l) && worthPacking(t, b_l)) {
+    t0 = statsStart();
+    packedSeq * pp = packSeq(p, a_l);
+    packedSeq * pt = packSeq(t, b_l);
+    statsStop(PHASE_PACK, t0);
+    t0 = statsStart();
+    index = zalg_packed_match(pp, pt);
+    statsStop(PHASE_SEARCH, t0);
+    freePackedSeq(pp);
+    freePackedSeq(pt);
+  } else {
+    t0 = statsStart();
+    index = zalg_pattern_match(p, t);
+    statsStop(PHASE_SEARCH, t0);
+  }
+  statsAdd(COUNT_QUERIES, 1);
+  statsAdd(COUNT_TEXT_CHARS, index < b_l ? index + a_l : b_l);
 
   // after doing the z algorithm, print results.
-  size_t a_l = strlen(p);
-  size_t b_l = strlen(t);
 
   if (index == b_l) {
     fprintf(stdout, "pattern did not match\n");
@@ -66,11 +86,12 @@ int main(int argc, char ** argv) {
     }
     fprintf(stdout, "\n");
   }
-  free(t);
+  if (copied) free(t);
+  if (!ctx) freeSeqSet(set);
   return 0;
 }
 
-size_t z_pattern_match(char * p, char * t) {
+size_t zalg_pattern_match(char * p, char * t) {
   if (p == NULL || t == NULL) return (size_t) -1;
   size_t t_l = strlen(t);
   size_t p_l = strlen(p);
@@ -126,3 +147,39 @@ size_t z_pattern_match(char * p, char * t) {
   free(z_values);
   return i;
 }
+
+// the z algorithm of zalg_pattern_match on packed strings. Each run of
+// character comparisons is one packedPrefixMatch, which compares a word of
+// bases at a time.
+size_t zalg_packed_match(packedSeq * p, packedSeq * t) {
+  size_t t_l = t->n;
+  size_t p_l = p->n;
+
+  size_t l = 0;
+  size_t r = 0;
+
+  size_t * z_values = malloc((p_l ? p_l : 1) * sizeof(size_t));
+  for (size_t i = 1; i < p_l; i++) {
+    z_values[i] = packedPrefixMatch(p, 0, p, i, p_l - i);
+  }
+  size_t i = 0;
+  for (; i < t_l; i++) {
+    size_t max = t_l - i < p_l ? t_l - i : p_l; // the longest match possible at i
+    if (i < r) {
+      // continue the match from the end of the frame if the pattern's own z
+      // value reaches exactly to it
+      if (z_values[i - l] + i == r) {
+        l = i;
+        if (r - i < max) r += packedPrefixMatch(p, r - i, t, r, max - (r - i));
+      }
+    } else {
+      l = i;
+      r = i + packedPrefixMatch(p, 0, t, i, max);
+    }
+    if (r - l == p_l) {
+      break;
+    }
+  }
+  free(z_values);
+  return i;
+}
@@ -0,0 +1,278 @@
+/**********************************************************************
+ * checks the centerstar score cache against the scores it stands for *
+ * cachecheck.c                                                       *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "centerStar.h"
+#include "scoreCache.h"
+
+#define ROUNDS      60   // random sets of strings
+#define MAX_STRINGS 10   // strings in a set
+#define MAX_LEN     50   // length of a string
+#define ENTRIES     3000 // raw entries, enough to grow the table a few times
+
+// mismatch and indel costs, alpha and beta
+static const int SCORES [][2] = { { 1, 1 }, { 1, 2 }, { 3, 2 } };
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same sets
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+static long fileSize(char * path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+// the cheapest alignment of s and t under mismatch cost alpha and indel cost
+// beta, over the whole table
+static int plainDistance(char * s, char * t, int alpha, int beta) {
+  size_t n = strlen(s);
+  size_t m = strlen(t);
+  int * D = malloc(sizeof(int) * (n + 1) * (m + 1));
+  for (size_t x = 0; x <= n; x++) {
+    for (size_t y = 0; y <= m; y++) {
+      int d;
+      if (x == 0 || y == 0) {
+        d = (x + y) * beta;
+      } else {
+        d = D[(x - 1) * (m + 1) + y - 1] + (s[x - 1] == t[y - 1] ? 0 : alpha);
+        int u = D[(x - 1) * (m + 1) + y] + beta;
+        int l = D[x * (m + 1) + y - 1] + beta;
+        if (u < d) d = u;
+        if (l < d) d = l;
+      }
+      D[x * (m + 1) + y] = d;
+    }
+  }
+  int d = D[n * (m + 1) + m];
+  free(D);
+  return d;
+}
+
+// fills the cache file at path with random entries under two pairs of
+// scores, one open at a time, and checks what comes back when it is opened
+// again: every entry of the first pair by either order of its hashes, the
+// latest score of a pair saved twice, and nothing of the second pair. A
+// torn entry at the end, as from a run that was killed, must not hide the
+// entries before it or garble the ones added after it.
+static bool checkEntries(char * path) {
+  uint64_t (* keys)[2] = malloc(sizeof(uint64_t) * 2 * ENTRIES);
+  int * scores = malloc(sizeof(int) * ENTRIES);
+  size_t distinct = 0;
+  unlink(path);
+  scoreCache * cache = openScoreCache(path, 1, 1);
+  for (int k = 0; k < ENTRIES; k++) {
+    // now and then save an earlier pair again with a new score
+    bool again = k > 0 && below(10) == 0;
+    int from = again ? below(k) : k;
+    if (!again) {
+      distinct++;
+      keys[k][0] = nextRandom();
+      keys[k][1] = nextRandom();
+    } else {
+      keys[k][0] = keys[from][0];
+      keys[k][1] = keys[from][1];
+    }
+    scores[k] = -(int) below(1000);
+    cacheInsert(cache, keys[k][0], keys[k][1], scores[k]);
+    for (int j = 0; again && j < k; j++) {
+      if (keys[j][0] == keys[k][0] && keys[j][1] == keys[k][1]) scores[j] = scores[k];
+    }
+  }
+  closeScoreCache(cache);
+
+  cache = openScoreCache(path, 1, 2);
+  for (int k = 0; k < ENTRIES / 2; k++) {
+    cacheInsert(cache, nextRandom(), nextRandom(), 1);
+  }
+  closeScoreCache(cache);
+
+  // a torn entry, then one more whole entry after it
+  FILE * pFile = fopen(path, "ab");
+  fwrite(keys, 1, sizeof(cacheEntry) / 2, pFile);
+  fclose(pFile);
+  cache = openScoreCache(path, 1, 1);
+  uint64_t ha = nextRandom();
+  uint64_t hb = nextRandom();
+  if (cache) cacheInsert(cache, ha, hb, -7);
+  closeScoreCache(cache);
+
+  cache = openScoreCache(path, 1, 1);
+  bool ok = cache != NULL;
+  int score;
+  for (int k = 0; k < ENTRIES && ok; k++) {
+    int got [2] = { 0, 0 };
+    bool found = cacheLookup(cache, keys[k][0], keys[k][1], &got[0]) &&
+      cacheLookup(cache, keys[k][1], keys[k][0], &got[1]);
+    if (!found || got[0] != scores[k] || got[1] != scores[k]) {
+      fprintf(stderr, "entry %d was saved with score %d and read back as %d and %d\n",
+        k, scores[k], got[0], got[1]);
+      ok = false;
+    }
+  }
+  if (ok && (!cacheLookup(cache, ha, hb, &score) || score != -7)) {
+    fprintf(stderr, "the entry saved after a torn one was lost\n");
+    ok = false;
+  }
+  if (ok && cache->n != distinct + 1) {
+    fprintf(stderr, "the cache loaded %zu entries where %zu were saved\n", cache->n, distinct + 1);
+    ok = false;
+  }
+  closeScoreCache(cache);
+  free(keys);
+  free(scores);
+  return ok;
+}
+
+// a set of strings mostly mutated from one ancestor, with the odd exact copy
+// so some pairs share their hashes
+static uint32_t randomSet(char ** pStrings) {
+  uint32_t n = 2 + below(MAX_STRINGS - 1);
+  size_t len = 1 + below(MAX_LEN);
+  char base [MAX_LEN + 1];
+  for (size_t i = 0; i < len; i++) {
+    base[i] = "ACGT"[below(4)];
+  }
+  base[len] = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    if (i > 0 && below(8) == 0) {
+      pStrings[i] = strdup(pStrings[below(i)]);
+      continue;
+    }
+    pStrings[i] = strdup(base);
+    for (size_t j = 0; j < len; j++) {
+      if (below(5) == 0) pStrings[i][j] = "ACGT"[below(4)];
+    }
+  }
+  return n;
+}
+
+// picks the center of a set with no cache, with an empty cache and with the
+// cache the first run filled, and checks that all three agree, that every
+// pair was saved with its score, and that the second run saved nothing new
+static bool checkCenter(char * path, char ** pStrings, uint32_t n, int alpha, int beta) {
+  unlink(path);
+  starOptions opts = { 1, false, false, NULL };
+  uint32_t plain = minSequenceDistance(pStrings, n, alpha, beta, &opts);
+  opts.cache = openScoreCache(path, alpha, beta);
+  uint32_t first = minSequenceDistance(pStrings, n, alpha, beta, &opts);
+  closeScoreCache(opts.cache);
+  long size = fileSize(path);
+
+  opts.cache = openScoreCache(path, alpha, beta);
+  bool ok = true;
+  for (uint32_t i = 0; i < n && ok; i++) {
+    for (uint32_t j = i + 1; j < n && ok; j++) {
+      int score = 1;
+      cacheLookup(opts.cache, stringHash(pStrings[i]), stringHash(pStrings[j]), &score);
+      int d = plainDistance(pStrings[i], pStrings[j], alpha, beta);
+      if (score != -d) {
+        fprintf(stderr, "S%u and S%u are %d apart under %d %d and the cache has %d\n",
+          i + 1, j + 1, d, alpha, beta, score);
+        ok = false;
+      }
+    }
+  }
+  uint32_t second = minSequenceDistance(pStrings, n, alpha, beta, &opts);
+  closeScoreCache(opts.cache);
+
+  if (ok && (first != plain || second != plain)) {
+    fprintf(stderr, "under %d %d the center is S%u, S%u with an empty cache and S%u from a full one\n",
+      alpha, beta, plain + 1, first + 1, second + 1);
+    ok = false;
+  }
+  if (ok && fileSize(path) != size) {
+    fprintf(stderr, "a run with every pair cached grew the cache from %ld to %ld bytes\n", size, fileSize(path));
+    ok = false;
+  }
+  if (!ok) {
+    for (uint32_t i = 0; i < n; i++) {
+      fprintf(stderr, "  %s\n", pStrings[i]);
+    }
+  }
+  return ok;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  state = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+  // the center search prints its table on stdout
+  freopen("/dev/null", "w", stdout);
+
+  char path [] = "/tmp/cachecheckXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    fprintf(stderr, "cache: can't make a file in /tmp\n");
+    return 1;
+  }
+  close(fd);
+
+  bool ok = checkEntries(path);
+
+  // a file that isn't a cache is refused, quietly here
+  if (ok) {
+    FILE * pFile = fopen(path, "wb");
+    fputs("not a cache at all", pFile);
+    fclose(pFile);
+    int err = dup(2);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, 2);
+    close(null);
+    scoreCache * cache = openScoreCache(path, 1, 1);
+    dup2(err, 2);
+    close(err);
+    if (cache) {
+      fprintf(stderr, "a file that isn't a cache was opened as one\n");
+      closeScoreCache(cache);
+      ok = false;
+    }
+  }
+
+  size_t nScores = sizeof(SCORES) / sizeof(SCORES[0]);
+  size_t nSets = 0;
+  char * pStrings [MAX_STRINGS];
+  for (int round = 0; round < ROUNDS && ok; round++) {
+    uint32_t n = randomSet(pStrings);
+    ok = checkCenter(path, pStrings, n, SCORES[round % nScores][0], SCORES[round % nScores][1]);
+    for (uint32_t i = 0; i < n; i++) {
+      free(pStrings[i]);
+    }
+    nSets++;
+  }
+  unlink(path);
+
+  if (!ok) {
+    fprintf(stderr, "cache: FAILED\n");
+    return 1;
+  }
+  fprintf(stderr, "cache: %d entries and %zu sets: saved scores come back and centers match an uncached run\n",
+    ENTRIES, nSets);
+  return 0;
+}
@@ -0,0 +1,198 @@
+/**********************************************************************
+ * checks the pruned center search against the full distance table    *
+ * centercheck.c                                                      *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "centerStar.h"
+
+#define ROUNDS      150 // random sets for each pair of scores
+#define MAX_STRINGS 9   // strings in a set
+#define MAX_LEN     40  // length of a set's first string
+
+// mismatch and indel costs, alpha and beta
+static const int SCORES [][2] = { { 1, 1 }, { 0, 1 }, { 1, 2 }, { 2, 1 }, { 3, 2 } };
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same sets
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+// a copy of src with an edit at each position with chance pct in 100
+static char * mutated(char * src, size_t pct) {
+  size_t n = strlen(src);
+  char * out = malloc(2 * n + 2);
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t u = below(100);
+    if (u >= pct) {
+      out[m++] = src[i];
+    } else if (u % 4 < 2) {
+      out[m++] = "ACGT"[below(4)];
+    } else if (u % 4 == 2) {
+      out[m++] = src[i];
+      out[m++] = "ACGT"[below(4)];
+    }
+  }
+  if (m == 0) out[m++] = 'A';
+  out[m] = 0;
+  return out;
+}
+
+// a set of strings mostly mutated from one ancestor, with the odd exact
+// copy so rows tie, and the odd unrelated string
+static uint32_t randomSet(char ** pStrings) {
+  uint32_t n = 2 + below(MAX_STRINGS - 1);
+  char base [MAX_LEN + 1];
+  size_t len = 1 + below(MAX_LEN);
+  for (size_t i = 0; i < len; i++) {
+    base[i] = "ACGT"[below(4)];
+  }
+  base[len] = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    size_t kind = below(10);
+    if (kind == 0 && i > 0) {
+      pStrings[i] = strdup(pStrings[below(i)]);
+    } else if (kind == 1) {
+      pStrings[i] = mutated(base, 100);
+    } else {
+      pStrings[i] = mutated(base, below(40));
+    }
+  }
+  return n;
+}
+
+// the cheapest alignment of s and t under mismatch cost alpha and indel cost
+// beta, over the whole table
+static int plainDistance(char * s, char * t, int alpha, int beta) {
+  size_t n = strlen(s);
+  size_t m = strlen(t);
+  int * D = malloc(sizeof(int) * (n + 1) * (m + 1));
+  for (size_t x = 0; x <= n; x++) {
+    for (size_t y = 0; y <= m; y++) {
+      int d;
+      if (x == 0 || y == 0) {
+        d = (x + y) * beta;
+      } else {
+        d = D[(x - 1) * (m + 1) + y - 1] + (s[x - 1] == t[y - 1] ? 0 : alpha);
+        int u = D[(x - 1) * (m + 1) + y] + beta;
+        int l = D[x * (m + 1) + y - 1] + beta;
+        if (u < d) d = u;
+        if (l < d) d = l;
+      }
+      D[x * (m + 1) + y] = d;
+    }
+  }
+  int d = D[n * (m + 1) + m];
+  free(D);
+  return d;
+}
+
+// boundedDistance must give the distance when it is within the cutoff, and
+// something over the cutoff otherwise
+static bool checkBounded(char * s, char * t, int alpha, int beta, dpArena * arena) {
+  int d = plainDistance(s, t, alpha, beta);
+  int64_t cutoffs [3] = { INT_MAX / 2, d, below(2 * d + 2) };
+  for (int k = 0; k < 3; k++) {
+    uint64_t cells = 0;
+    arenaReset(arena);
+    int got = boundedDistance(s, strlen(s), t, strlen(t), alpha, beta, cutoffs[k], arena, &cells);
+    if (d <= cutoffs[k] ? got != d : got <= cutoffs[k]) {
+      fprintf(stderr, "boundedDistance(%s, %s) under %d %d with cutoff %lld gave %d, distance is %d\n",
+        s, t, alpha, beta, (long long) cutoffs[k], got, d);
+      return false;
+    }
+  }
+  return true;
+}
+
+// four strings of one letter each under costs so high that every row sums
+// past INT_MAX / 2, which the pruned search once took as its first budget
+// and so dropped every candidate
+static bool checkHeavyCosts(starOptions * opts) {
+  char * pStrings [4] = { "AAAAAAAAAA", "CCCCCCCCCC", "GGGGGGGGGGG", "TTTTTTTTTT" };
+  int cost = 40000000;
+  uint32_t full = minSequenceDistance(pStrings, 4, cost, cost, opts);
+  uint32_t pruned = prunedCenter(pStrings, 4, cost, cost, opts);
+  if (full != pruned) {
+    fprintf(stderr, "with rows over INT_MAX / 2 the full table picks S%u and the pruned search S%u\n",
+      full + 1, pruned + 1);
+    return false;
+  }
+  return true;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  state = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+  // both searches print their work on stdout
+  freopen("/dev/null", "w", stdout);
+
+  size_t nScores = sizeof(SCORES) / sizeof(SCORES[0]);
+  starOptions opts = { 1, false, true, NULL };
+  dpArena arena = { NULL, 0, 0 };
+  char * pStrings [MAX_STRINGS];
+  size_t nSets = 0;
+  size_t nPairs = 0;
+  bool ok = true;
+  for (size_t k = 0; k < nScores && ok; k++) {
+    int alpha = SCORES[k][0];
+    int beta = SCORES[k][1];
+    for (int round = 0; round < ROUNDS && ok; round++) {
+      uint32_t n = randomSet(pStrings);
+      uint32_t full = minSequenceDistance(pStrings, n, alpha, beta, &opts);
+      uint32_t pruned = prunedCenter(pStrings, n, alpha, beta, &opts);
+      if (full != pruned) {
+        fprintf(stderr, "under %d %d the full table picks S%u and the pruned search S%u of:\n",
+          alpha, beta, full + 1, pruned + 1);
+        for (uint32_t i = 0; i < n; i++) {
+          fprintf(stderr, "  %s\n", pStrings[i]);
+        }
+        ok = false;
+      }
+      for (uint32_t i = 0; i < n && ok; i++) {
+        for (uint32_t j = i + 1; j < n && ok; j++) {
+          ok = checkBounded(pStrings[i], pStrings[j], alpha, beta, &arena);
+          nPairs++;
+        }
+      }
+      for (uint32_t i = 0; i < n; i++) {
+        free(pStrings[i]);
+      }
+      nSets++;
+    }
+  }
+  freeArena(&arena);
+  ok = ok && checkHeavyCosts(&opts);
+
+  if (!ok) {
+    fprintf(stderr, "center: FAILED\n");
+    return 1;
+  }
+  fprintf(stderr, "center: %zu sets, %zu pairs over %zu score pairs: pruned center and bounded distances match\n",
+    nSets, nPairs, nScores);
+  return 0;
+}
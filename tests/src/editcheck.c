@@ -0,0 +1,241 @@
+/**********************************************************************
+ * checks the bit-parallel edit distance against a full DP table      *
+ * editcheck.c                                                        *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "align.h"
+#include "editdist.h"
+
+#define ROUNDS  600 // random pairs of strings
+#define MAX_LEN 300 // length of a random string
+
+// lengths on either side of the 64-row word boundaries
+static const size_t EDGES [] = { 0, 1, 2, 63, 64, 65, 127, 128, 129, 191, 192, 193 };
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same strings
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+static size_t randomLength(void) {
+  if (below(2)) return EDGES[below(sizeof(EDGES) / sizeof(EDGES[0]))];
+  return below(MAX_LEN + 1);
+}
+
+// n characters from a two letter, DNA or byte alphabet. Bytes leave out the
+// gap character and NUL.
+static void randomString(char * out, size_t n, int alph) {
+  for (size_t i = 0; i < n; i++) {
+    if (alph == 0) {
+      out[i] = "AB"[below(2)];
+    } else if (alph == 1) {
+      out[i] = "ACGT"[below(4)];
+    } else {
+      do out[i] = 1 + below(255); while (out[i] == '_');
+    }
+  }
+  out[n] = 0;
+}
+
+// t is s with edits now and then, so the pair is close enough to have many
+// optimal alignments
+static void nearString(char * out, char * s, size_t n, int alph) {
+  char c [2];
+  size_t m = 0;
+  for (size_t i = 0; i < n && m < MAX_LEN; i++) {
+    size_t u = below(10);
+    randomString(c, 1, alph);
+    if (u > 0) out[m++] = s[i];
+    if (u == 1 && m < MAX_LEN) out[m++] = c[0];
+    if (u == 2) out[m - 1] = c[0];
+  }
+  out[m] = 0;
+}
+
+// the unit cost edit distance table of s against t, (n + 1) by (m + 1)
+static int * plainTable(char * s, size_t n, char * t, size_t m) {
+  int * D = malloc(sizeof(int) * (n + 1) * (m + 1));
+  for (size_t x = 0; x <= n; x++) {
+    for (size_t y = 0; y <= m; y++) {
+      int d;
+      if (x == 0 || y == 0) {
+        d = x + y;
+      } else {
+        d = D[(x - 1) * (m + 1) + y - 1] + (s[x - 1] != t[y - 1]);
+        int u = D[(x - 1) * (m + 1) + y] + 1;
+        int l = D[x * (m + 1) + y - 1] + 1;
+        if (u < d) d = u;
+        if (l < d) d = l;
+      }
+      D[x * (m + 1) + y] = d;
+    }
+  }
+  return D;
+}
+
+static char * reversed(char * s, size_t n) {
+  char * r = malloc(n + 1);
+  for (size_t i = 0; i < n; i++) {
+    r[i] = s[n - 1 - i];
+  }
+  r[n] = 0;
+  return r;
+}
+
+// the alignment globalAlignment writes, walked over the full tables: from
+// the start, take the preferred move among those on an optimal path, where
+// a move is on one if it costs what the forward table says and the reverse
+// table can finish from where it lands
+static char * plainAlignment(char * s, size_t n, char * t, size_t m, tiePreference prefer) {
+  int * F = plainTable(s, n, t, m);
+  char * rs = reversed(s, n);
+  char * rt = reversed(t, m);
+  int * B = plainTable(rs, n, rt, m);
+  int total = F[n * (m + 1) + m];
+  char * Sa = malloc(2 * (n + m) + 2);
+  char * Ta = malloc(n + m + 1);
+  size_t x = 0;
+  size_t y = 0;
+  size_t i = 0;
+  while (x < n || y < m) {
+    // diagonal, left (a gap in s), up (a gap in t)
+    int dx [3] = { 1, 0, 1 };
+    int dy [3] = { 1, 1, 0 };
+    bool on [3];
+    for (int k = 0; k < 3; k++) {
+      size_t nx = x + dx[k];
+      size_t ny = y + dy[k];
+      int cost = k == 0 ? (nx <= n && ny <= m && s[x] != t[y]) : 1;
+      on[k] = nx <= n && ny <= m && F[x * (m + 1) + y] + cost == F[nx * (m + 1) + ny] &&
+        F[nx * (m + 1) + ny] + B[(n - nx) * (m + 1) + (m - ny)] == total;
+    }
+    int step = 0;
+    if (prefer == PREFER_DIAGONAL && on[0]) step = 0;
+    else if (on[1]) step = 1;
+    else if (on[2]) step = 2;
+    Sa[i] = dx[step] ? s[x] : '_';
+    Ta[i] = dy[step] ? t[y] : '_';
+    x += dx[step];
+    y += dy[step];
+    i++;
+  }
+  Sa[i] = '\n';
+  memcpy(Sa + i + 1, Ta, i);
+  Sa[2 * i + 1] = 0;
+  free(Ta);
+  free(F);
+  free(B);
+  free(rs);
+  free(rt);
+  return Sa;
+}
+
+// compares every way the bit-parallel kernel is used on s and t with the
+// full table
+static bool checkPair(char * s, char * t, dpArena * arena) {
+  size_t n = strlen(s);
+  size_t m = strlen(t);
+  int * D = plainTable(s, n, t, m);
+  int d = D[n * (m + 1) + m];
+  bool ok = true;
+
+  // the distance, either way round, with and without a cutoff
+  int64_t cutoff = below(d + 3);
+  arenaReset(arena);
+  int got = editDistance(s, n, t, m, EDIT_NO_CUTOFF, arena, NULL);
+  int gotSwapped = editDistance(t, m, s, n, EDIT_NO_CUTOFF, arena, NULL);
+  int gotCut = editDistance(s, n, t, m, cutoff, arena, NULL);
+  if (got != d || gotSwapped != d || (d <= cutoff ? gotCut != d : gotCut <= cutoff)) {
+    fprintf(stderr, "editDistance gave %d, %d swapped and %d under cutoff %lld, distance is %d\n",
+      got, gotSwapped, gotCut, (long long) cutoff, d);
+    ok = false;
+  }
+
+  // every cell of the matrix
+  arenaReset(arena);
+  editColumns cols = editMatrix(s, n, t, m, arena);
+  for (size_t x = 0; x <= n && ok; x++) {
+    for (size_t y = 0; y <= m && ok; y++) {
+      if (editCell(&cols, x, y) != D[x * (m + 1) + y]) {
+        fprintf(stderr, "editCell(%zu, %zu) gave %d, table has %d\n", x, y, editCell(&cols, x, y), D[x * (m + 1) + y]);
+        ok = false;
+      }
+    }
+  }
+
+  // the score alone, scaled, and the alignment written under both preferences
+  arenaReset(arena);
+  if (ok && (globalAlignment(s, t, 0, -1, -1, PREFER_DIAGONAL, arena, NULL) != -d ||
+      globalAlignment(s, t, 0, -3, -3, PREFER_DIAGONAL, arena, NULL) != -3 * d)) {
+    fprintf(stderr, "globalAlignment scored the pair other than -%d\n", d);
+    ok = false;
+  }
+  for (int p = 0; p < 2 && ok; p++) {
+    tiePreference prefer = p ? PREFER_GAP : PREFER_DIAGONAL;
+    char * aligned;
+    arenaReset(arena);
+    int score = globalAlignment(s, t, 0, -1, -1, prefer, arena, &aligned);
+    char * expected = plainAlignment(s, n, t, m, prefer);
+    if (score != -d || strcmp(aligned, expected) != 0) {
+      fprintf(stderr, "globalAlignment with %s ties scored %d and wrote\n%s\nexpected -%d and\n%s\n",
+        p ? "gap" : "diagonal", score, aligned, d, expected);
+      ok = false;
+    }
+    free(expected);
+  }
+
+  if (!ok) fprintf(stderr, "on the pair\n%s\n%s\n", s, t);
+  free(D);
+  return ok;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  state = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+
+  dpArena arena = { NULL, 0, 0 };
+  char s [MAX_LEN + 1];
+  char t [MAX_LEN + 1];
+  bool ok = true;
+  for (int round = 0; round < ROUNDS && ok; round++) {
+    int alph = below(3);
+    randomString(s, randomLength(), alph);
+    if (below(2)) {
+      nearString(t, s, strlen(s), alph);
+    } else {
+      randomString(t, randomLength(), alph);
+    }
+    ok = checkPair(s, t, &arena);
+  }
+  freeArena(&arena);
+
+  if (!ok) {
+    fprintf(stderr, "editdist: FAILED\n");
+    return 1;
+  }
+  fprintf(stderr, "editdist: %d pairs: distances, cells and alignments match the full table\n", ROUNDS);
+  return 0;
+}
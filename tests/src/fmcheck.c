@@ -0,0 +1,561 @@
+/**********************************************************************
+ * checks fmsearch backward search against a plain substring scan     *
+ * fmcheck.c                                                          *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fmindex.h"
+#include "fmstore.h"
+#include "lcp.h"
+
+#define ROUNDS      200 // random texts
+#define MAX_RECORDS 12  // records in a text
+#define MAX_LEN     200 // length of a record
+#define MAX_QUERY   16  // length of a pattern
+#define QUERIES     40  // patterns searched in each text
+#define REPEAT_TEXT 600 // longest text whose repeats are found by brute force
+
+#define MAX_HITS (MAX_RECORDS * MAX_LEN)
+
+// the records of a random text. Record i is named r<i> in every index built
+// from it, so hits can be traced back whichever segment holds them.
+typedef struct text_S {
+  int n;
+  char * seq [MAX_RECORDS];
+} text;
+
+// two letters give many hits, DNA the dense occurrence table and protein
+// the wavelet matrix. main adds every byte a record may hold, for a matrix
+// of seven levels.
+static const char * ALPHABETS [] = { "AC", "ACGT", "ACDEFGHIKLMNPQRSTVWY" };
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same texts
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+// records of up to MAX_LEN characters from alph, now and then empty
+static void randomText(text * t, const char * alph) {
+  size_t k = strlen(alph);
+  t->n = 1 + below(MAX_RECORDS);
+  for (int i = 0; i < t->n; i++) {
+    size_t len = below(8) ? below(MAX_LEN + 1) : 0;
+    t->seq[i] = malloc(len + 1);
+    for (size_t j = 0; j < len; j++) {
+      t->seq[i][j] = alph[below(k)];
+    }
+    t->seq[i][len] = 0;
+  }
+}
+
+static void freeText(text * t) {
+  for (int i = 0; i < t->n; i++) {
+    free(t->seq[i]);
+  }
+}
+
+// records first to first + count - 1 joined the way fmReadRecords joins
+// them, with a record table naming each one after its place in t
+static char * joinRecords(text * t, int first, int count, size_t * pn, recordTable ** precords) {
+  size_t cap = 2;
+  for (int i = first; i < first + count; i++) {
+    cap += strlen(t->seq[i]) + 1;
+  }
+  char * s = malloc(cap);
+  size_t n = 0;
+  recordTable * records = makeRecordTable();
+  for (int i = first; i < first + count; i++) {
+    char name [16];
+    snprintf(name, sizeof(name), "r%d", i);
+    if (i > first) s[n++] = RECORD_SEP;
+    addRecord(records, name, strlen(name), n);
+    memcpy(s + n, t->seq[i], strlen(t->seq[i]));
+    n += strlen(t->seq[i]);
+  }
+  s[n++] = TEXT_END;
+  s[n] = 0;
+  *pn = n;
+  *precords = records;
+  return s;
+}
+
+static fmIndex * buildIndex(text * t, int first, int count) {
+  size_t n;
+  recordTable * records;
+  char * s = joinRecords(t, first, count, &n, &records);
+  return makeFmIndex(s, n, NULL, NULL, records);
+}
+
+// a hit as its record and its offset in that record, so hits sort by both
+static uint64_t hitKey(int rec, int off) {
+  return (uint64_t) rec << 32 | (uint32_t) off;
+}
+
+static int compareKeys(const void * a, const void * b) {
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+// every place q occurs inside a record, by trying each one
+static size_t plainHits(text * t, char * q, size_t m, uint64_t * hits) {
+  size_t nHits = 0;
+  for (int i = 0; i < t->n; i++) {
+    size_t len = strlen(t->seq[i]);
+    for (size_t j = 0; j + m <= len; j++) {
+      if (memcmp(t->seq[i] + j, q, m) == 0) hits[nHits++] = hitKey(i, j);
+    }
+  }
+  return nHits;
+}
+
+// every place q occurs in col, found by backward search in each segment
+static size_t fmHits(fmCollection * col, char * q, size_t m, uint64_t * hits) {
+  size_t nHits = 0;
+  for (int k = 0; k < col->nSeg; k++) {
+    fmIndex * index = col->seg[k];
+    int st, ed;
+    if (!fmRange(index, q, m, &st, &ed)) continue;
+    for (int i = st; i <= ed && nHits < MAX_HITS + 1; i++) {
+      int r = findRecord(index->records, index->SA[i]);
+      int rec = atoi(recordName(index->records, r) + 1);
+      hits[nHits++] = hitKey(rec, index->SA[i] - index->records->start[r]);
+    }
+  }
+  qsort(hits, nHits, sizeof(uint64_t), compareKeys);
+  return nHits;
+}
+
+// a pattern to search t for: a piece of a record, a random string, or one
+// holding a separator or a byte no record can hold, which must never match
+static size_t randomQuery(text * t, const char * alph, char * q) {
+  size_t k = strlen(alph);
+  size_t kind = below(6);
+  size_t m = 1 + below(MAX_QUERY / 2);
+  if (kind < 3) {
+    char * seq = t->seq[below(t->n)];
+    size_t len = strlen(seq);
+    if (len == 0) return 0;
+    if (m > len) m = len;
+    memcpy(q, seq + below(len - m + 1), m);
+    return m;
+  }
+  for (size_t j = 0; j < m; j++) {
+    q[j] = alph[below(k)];
+  }
+  if (kind == 3) return m;
+
+  // the end of one record, a separator and the start of the next
+  if (kind == 4 && t->n > 1) {
+    int i = below(t->n - 1);
+    size_t a = strlen(t->seq[i]);
+    size_t b = strlen(t->seq[i + 1]);
+    size_t x = below(MAX_QUERY / 2 < a ? MAX_QUERY / 2 : a + 1);
+    size_t y = below(MAX_QUERY / 2 - 1 < b ? MAX_QUERY / 2 - 1 : b + 1);
+    memcpy(q, t->seq[i] + a - x, x);
+    q[x] = RECORD_SEP;
+    memcpy(q + x + 1, t->seq[i + 1], y);
+    return x + 1 + y;
+  }
+  static const char BAD [] = { RECORD_SEP, TEXT_END, 0, 127, (char) 200 };
+  q[below(m)] = BAD[below(sizeof(BAD))];
+  return m;
+}
+
+// the occurrence counts of the index, and of a wavelet matrix built over the
+// same BW string whatever its alphabet, against counts of the BW string
+static bool checkOcc(fmIndex * index) {
+  occTable * occ = index->occ;
+  int n = index->n;
+  if ((occ->wm != NULL) != occNeedsWavelet(index->BW, n)) {
+    fprintf(stderr, "a text of %d symbols keeps its occurrences %s\n",
+      occ->alphn, occ->wm ? "as a wavelet matrix" : "as counts");
+    return false;
+  }
+  waveletMatrix * wm = makeWaveletMatrix(index->BW, n, occ->map, occ->alphn);
+  occTable * forced = makeOccTable(index->BW, n, wm);
+  int counts [128] = { 0 };
+  bool ok = true;
+  // from before the start to past the end, which both clamp
+  for (int i = -1; i <= n && ok; i++) {
+    if (i >= 0 && i < n) counts[(unsigned char) index->BW[i]]++;
+    for (int a = 0; a < occ->alphn && ok; a++) {
+      char c = occ->alph[a];
+      int want = counts[(unsigned char) c];
+      if (fmOcc(occ, c, i) != want || fmOcc(forced, c, i) != want) {
+        fprintf(stderr, "occurrences of %c to %d: %d from the %s table, %d from the matrix, %d counted\n",
+          c, i, fmOcc(occ, c, i), occ->wm ? "wavelet" : "dense", fmOcc(forced, c, i), want);
+        ok = false;
+      }
+    }
+  }
+  freeOccTable(forced);
+  return ok;
+}
+
+// saves the first few records of t as an index, appends the rest a few at a
+// time so segments are added and merged, and loads the index back. Returns
+// NULL if a step fails.
+static fmCollection * appendedIndex(text * t, char * path) {
+  size_t n;
+  recordTable * records;
+  int first = 0;
+  while (first < t->n) {
+    int count = 1 + below(below(2) ? t->n - first : 2);
+    if (count > t->n - first) count = t->n - first;
+    char * s = joinRecords(t, first, count, &n, &records);
+    bool ok = first == 0 ? writeIndexFile(path, s, n, records) : appendIndexFile(path, s, n, records);
+    if (!ok) return NULL;
+    first += count;
+  }
+  fmCollection * col = readIndexFile(path);
+  int nRec = 0;
+  for (int k = 0; col && k < col->nSeg; k++) {
+    nRec += col->seg[k]->records->n;
+  }
+  if (col && nRec != t->n) {
+    fprintf(stderr, "the saved index holds %d records of %d\n", nRec, t->n);
+    freeCollection(col);
+    return NULL;
+  }
+  return col;
+}
+
+// the repeat queries print their answers, so stdout goes to a scratch file
+// that is emptied before each query and read back after it
+static void startCapture(void) {
+  fflush(stdout);
+  rewind(stdout);
+  ftruncate(fileno(stdout), 0);
+}
+
+static char * endCapture(void) {
+  fflush(stdout);
+  long len = ftell(stdout);
+  char * out = malloc(len + 1);
+  rewind(stdout);
+  out[fread(out, 1, len, stdout)] = 0;
+  return out;
+}
+
+// the common prefix of the text at x and at y, up to a separator
+static int plainCommon(char * s, size_t n, size_t x, size_t y) {
+  int h = 0;
+  while (x + h < n && y + h < n && s[x + h] == s[y + h] && seqSymbol(s[x + h])) {
+    h++;
+  }
+  return h;
+}
+
+// the character after or before an occurrence of a repeat, where a
+// separator, the text end or the text start is unlike any other
+static int sideChar(char * s, size_t n, long i) {
+  if (i < 0 || i >= (long) n || !seqSymbol(s[i])) return -1;
+  return (unsigned char) s[i];
+}
+
+// every maximal repeat of at least minLen characters, each written as its
+// count and the repeat itself, found by extending the string at every
+// position while it still occurs twice and keeping it at its first
+// occurrence
+static size_t plainRepeats(char * s, size_t n, int minLen, char ** out) {
+  size_t nOut = 0;
+  int * at = malloc(sizeof(int) * n);
+  for (size_t i = 0; i < n; i++) {
+    for (int len = 1; i + len <= n && seqSymbol(s[i + len - 1]); len++) {
+      // where the first len characters at i occur
+      int count = 0;
+      for (size_t j = 0; j + len <= n; j++) {
+        if (memcmp(s + i, s + j, len) == 0) at[count++] = j;
+      }
+      if (count < 2) break;
+      if (len < minLen || at[0] != (int) i) continue;
+      bool right = false;
+      bool left = false;
+      for (int k = 0; k < count; k++) {
+        int r = sideChar(s, n, at[k] + len);
+        int l = sideChar(s, n, (long) at[k] - 1);
+        right |= r < 0 || r != sideChar(s, n, at[0] + len);
+        left |= l < 0 || l != sideChar(s, n, (long) at[0] - 1);
+      }
+      if (!right || !left) continue;
+      out[nOut] = malloc(len + 16);
+      snprintf(out[nOut], len + 16, "%d %.*s", count, len, s + i);
+      nOut++;
+    }
+  }
+  free(at);
+  return nOut;
+}
+
+static int compareStrings(const void * a, const void * b) {
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// reads a position printed as a record name and an offset, and returns the
+// text position, or -1 if there is no such record
+static int readPos(fmIndex * index, char ** pLine) {
+  char name [16];
+  int off;
+  int used;
+  if (sscanf(*pLine, "\t%15s\t%d%n", name, &off, &used) != 2) return -1;
+  *pLine += used;
+  recordTable * records = index->records;
+  for (int r = 0; r < records->n; r++) {
+    if (strcmp(recordName(records, r), name) == 0) return records->start[r] + off;
+  }
+  return -1;
+}
+
+// the LCP array, the longest repeat, the longest common substring of two
+// records and the maximal repeats of an index against brute force
+static bool checkRepeats(text * t, fmIndex * index) {
+  char * s = index->s;
+  int n = index->n;
+  int * LCP = lcpArray(s, n, index->SA);
+  bool ok = true;
+
+  int longest = 0;
+  for (int i = 1; i < n && ok; i++) {
+    int h = plainCommon(s, n, index->SA[i - 1], index->SA[i]);
+    if (LCP[i] != h) {
+      fprintf(stderr, "LCP[%d] is %d, the suffixes share %d\n", i, LCP[i], h);
+      ok = false;
+    }
+    if (h > longest) longest = h;
+  }
+
+  // the longest repeat: its length, and two places it really occurs
+  startCapture();
+  longestRepeat(index, LCP);
+  char * out = endCapture();
+  char * line = out;
+  int len = 0;
+  int used = 0;
+  sscanf(line, "%d%n", &len, &used);
+  line += used;
+  int x = readPos(index, &line);
+  int y = readPos(index, &line);
+  bool found = longest == 0 ? strcmp(out, "no repeats\n") == 0 :
+    len == longest && x >= 0 && y >= 0 && x != y && plainCommon(s, n, x, y) >= len;
+  if (ok && !found) {
+    fprintf(stderr, "the longest repeat is %d long, longestRepeat printed %s", longest, out);
+    ok = false;
+  }
+  free(out);
+
+  // the longest substring of two records, by dynamic programming over them
+  int a = below(t->n);
+  int b = below(t->n);
+  char * sa = t->seq[a];
+  char * sb = t->seq[b];
+  int la = strlen(sa);
+  int lb = strlen(sb);
+  int * D = calloc((la + 1) * (lb + 1), sizeof(int));
+  int common = 0;
+  for (int i = 1; i <= la; i++) {
+    for (int j = 1; j <= lb; j++) {
+      if (sa[i - 1] != sb[j - 1]) continue;
+      D[i * (lb + 1) + j] = D[(i - 1) * (lb + 1) + j - 1] + 1;
+      if (D[i * (lb + 1) + j] > common) common = D[i * (lb + 1) + j];
+    }
+  }
+  free(D);
+  char nameA [16];
+  char nameB [16];
+  snprintf(nameA, sizeof(nameA), "r%d", a);
+  snprintf(nameB, sizeof(nameB), "r%d", b);
+  startCapture();
+  longestCommon(index, LCP, nameA, nameB);
+  out = endCapture();
+  line = out;
+  len = 0;
+  used = 0;
+  sscanf(line, "%d%n", &len, &used);
+  line += used;
+  x = readPos(index, &line);
+  y = readPos(index, &line);
+  found = common == 0 ? strcmp(out, "no common substring\n") == 0 :
+    len == common && findRecord(index->records, x) == a && findRecord(index->records, y) == b &&
+    plainCommon(s, n, x, y) >= len;
+  if (ok && !found) {
+    fprintf(stderr, "r%d and r%d share %d characters, longestCommon printed %s", a, b, common, out);
+    ok = false;
+  }
+  free(out);
+
+  // the maximal repeats, compared as sets of counts and strings
+  int minLen = 1 + below(4);
+  char ** want = malloc(sizeof(char *) * n * (n + 1) / 2);
+  size_t nWant = plainRepeats(s, n, minLen, want);
+  startCapture();
+  maximalRepeats(index, LCP, minLen);
+  out = endCapture();
+  size_t nGot = 0;
+  for (char * p = out; *p; p++) {
+    nGot += *p == '\n';
+  }
+  char ** got = malloc(sizeof(char *) * (nGot + 1));
+  line = out;
+  for (size_t k = 0; k < nGot; k++) {
+    int count = 0;
+    len = 0;
+    used = 0;
+    sscanf(line, "%d\t%d%n", &len, &count, &used);
+    line += used;
+    x = readPos(index, &line);
+    line = strchr(line, '\n') + 1;
+    got[k] = malloc(len + 16);
+    snprintf(got[k], len + 16, "%d %.*s", count, len, x >= 0 ? s + x : "?");
+  }
+  qsort(want, nWant, sizeof(char *), compareStrings);
+  qsort(got, nGot, sizeof(char *), compareStrings);
+  bool same = nWant == nGot;
+  for (size_t k = 0; k < nWant && same; k++) {
+    same = strcmp(want[k], got[k]) == 0;
+  }
+  if (ok && !same) {
+    fprintf(stderr, "maximalRepeats of at least %d printed %zu repeats, brute force finds %zu\n",
+      minLen, nGot, nWant);
+    ok = false;
+  }
+  for (size_t k = 0; k < nWant; k++) {
+    free(want[k]);
+  }
+  for (size_t k = 0; k < nGot; k++) {
+    free(got[k]);
+  }
+  free(want);
+  free(got);
+  free(out);
+  free(LCP);
+
+  if (!ok) {
+    for (int i = 0; i < t->n; i++) {
+      fprintf(stderr, "  r%d %s\n", i, t->seq[i]);
+    }
+  }
+  return ok;
+}
+
+static void printQuery(char * q, size_t m) {
+  for (size_t j = 0; j < m; j++) {
+    if (q[j] > ' ' && q[j] < 127) fputc(q[j], stderr);
+    else fprintf(stderr, "\\x%02x", (unsigned char) q[j]);
+  }
+}
+
+// searches col, an index of all of t, for random patterns and compares the
+// hits with the plain scan
+static bool checkSearch(text * t, const char * alph, fmCollection * col, char * what) {
+  static uint64_t want [MAX_HITS + 1];
+  static uint64_t got [MAX_HITS + 1];
+  char q [MAX_QUERY + 1];
+  for (int k = 0; k < QUERIES; k++) {
+    size_t m = randomQuery(t, alph, q);
+    if (m == 0) continue;
+    size_t nWant = plainHits(t, q, m, want);
+    size_t nGot = fmHits(col, q, m, got);
+    if (nWant != nGot || memcmp(want, got, sizeof(uint64_t) * nWant) != 0) {
+      fprintf(stderr, "%s: ", what);
+      printQuery(q, m);
+      fprintf(stderr, " has %zu hits and the scan finds %zu in:\n", nGot, nWant);
+      for (int i = 0; i < t->n; i++) {
+        fprintf(stderr, "  r%d %s\n", i, t->seq[i]);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  state = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+
+  char wide [MAX_SYMBOL - TEXT_END + 1];
+  for (int c = TEXT_END + 1; c <= MAX_SYMBOL; c++) {
+    wide[c - TEXT_END - 1] = c;
+  }
+  wide[MAX_SYMBOL - TEXT_END] = 0;
+
+  char path [] = "/tmp/fmcheckXXXXXX";
+  char outPath [] = "/tmp/fmcheckXXXXXX";
+  int fd = mkstemp(path);
+  int outFd = mkstemp(outPath);
+  if (fd < 0 || outFd < 0 || !freopen(outPath, "w+", stdout)) {
+    fprintf(stderr, "fmindex: can't make a file in /tmp\n");
+    return 1;
+  }
+  close(fd);
+  close(outFd);
+
+  size_t nAlph = sizeof(ALPHABETS) / sizeof(ALPHABETS[0]);
+  size_t nTexts = 0;
+  size_t nWavelet = 0;
+  size_t nSegments = 0;
+  size_t nRepeats = 0;
+  bool ok = true;
+  for (int round = 0; round < ROUNDS && ok; round++) {
+    const char * alph = round % (nAlph + 1) < nAlph ? ALPHABETS[round % (nAlph + 1)] : wide;
+    text t;
+    randomText(&t, alph);
+
+    fmCollection * col = singleCollection(buildIndex(&t, 0, t.n));
+    nWavelet += col->seg[0]->occ->wm != NULL;
+    ok = checkOcc(col->seg[0]) && checkSearch(&t, alph, col, "in memory");
+    if (ok && col->seg[0]->n <= REPEAT_TEXT) {
+      ok = checkRepeats(&t, col->seg[0]);
+      nRepeats++;
+    }
+    freeCollection(col);
+
+    // the same records through the saved, appended and merged index
+    col = ok ? appendedIndex(&t, path) : NULL;
+    ok = col != NULL;
+    for (int k = 0; ok && k < col->nSeg; k++) {
+      ok = checkOcc(col->seg[k]);
+    }
+    ok = ok && checkSearch(&t, alph, col, "saved and appended");
+    if (col) nSegments += col->nSeg;
+    freeCollection(col);
+
+    freeText(&t);
+    nTexts++;
+  }
+
+  unlink(path);
+  unlink(outPath);
+
+  if (!ok) {
+    fprintf(stderr, "fmindex: FAILED\n");
+    return 1;
+  }
+  fprintf(stderr, "fmindex: %zu texts, %zu over wavelet matrices, %zu saved segments, %d patterns each, "
+    "%zu searched for repeats: occurrence counts, backward search and repeats match brute force\n",
+    nTexts, nWavelet, nSegments, QUERIES, nRepeats);
+  return 0;
+}
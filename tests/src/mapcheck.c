@@ -0,0 +1,332 @@
+/**********************************************************************
+ * checks fmsearch read mapping on reads simulated from a known place *
+ * mapcheck.c                                                         *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "fmindex.h"
+#include "fmstore.h"
+#include "mapper.h"
+
+#define ROUNDS      8    // random genomes
+#define MAX_RECORDS 3    // records in a genome
+#define MIN_RECORD  2000 // length of a record
+#define MAX_RECORD  6000
+#define READS       150  // reads simulated from each genome
+#define MIN_READ    60   // length of a read
+#define MAX_READ    150
+#define EDIT_PCT    2    // chance in 100 of an edit at each read position
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same genomes and reads
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+// the text of a genome of nRec random records named c0, c1, ..., joined the
+// way fmReadRecords joins them
+static char * randomGenome(int nRec, char ** seqs, size_t * pn, recordTable ** precords) {
+  char * s = malloc(MAX_RECORDS * (MAX_RECORD + 1) + 2);
+  size_t n = 0;
+  recordTable * records = makeRecordTable();
+  for (int i = 0; i < nRec; i++) {
+    char name [16];
+    snprintf(name, sizeof(name), "c%d", i);
+    if (i > 0) s[n++] = RECORD_SEP;
+    addRecord(records, name, strlen(name), n);
+    size_t len = MIN_RECORD + below(MAX_RECORD - MIN_RECORD + 1);
+    seqs[i] = s + n;
+    for (size_t j = 0; j < len; j++) {
+      s[n++] = "ACGT"[below(4)];
+    }
+  }
+  s[n++] = TEXT_END;
+  s[n] = 0;
+  *pn = n;
+  *precords = records;
+  return s;
+}
+
+// copies len characters of ref to out with an edit now and then, and
+// returns the length written. The number of edits goes to pEdits.
+static int mutate(char * out, char * ref, int len, int * pEdits) {
+  int m = 0;
+  int edits = 0;
+  for (int i = 0; i < len; i++) {
+    int u = below(100);
+    if (u >= EDIT_PCT) {
+      out[m++] = ref[i];
+      continue;
+    }
+    edits++;
+    if (u % 3 == 0) {
+      out[m++] = "ACGT"[(strchr("ACGT", ref[i]) - "ACGT" + 1 + below(3)) % 4];
+    } else if (u % 3 == 1) {
+      out[m++] = ref[i];
+      out[m++] = "ACGT"[below(4)];
+    }
+  }
+  *pEdits = edits;
+  return m;
+}
+
+// simulates the reads of one genome into a FASTA file. Each read is named
+// after its record, offset, strand and number of edits, and one read in
+// twenty holds a byte no record can hold and must come out unmapped.
+static void writeReads(char * path, int nRec, char ** seqs, int * lens) {
+  FILE * pFile = fopen(path, "w");
+  char read [2 * MAX_READ + 1];
+  char rc [2 * MAX_READ + 1];
+  for (int k = 0; k < READS; k++) {
+    int rec = below(nRec);
+    int len = MIN_READ + below(MAX_READ - MIN_READ + 1);
+    int off = below(lens[rec] - len + 1);
+    int edits;
+    int m = mutate(read, seqs[rec] + off, len, &edits);
+    char strand = below(2) ? '+' : '-';
+    if (strand == '-') {
+      reverseComplement(rc, read, m);
+      memcpy(read, rc, m);
+    }
+    bool bad = below(20) == 0;
+    if (bad) read[below(m)] = below(2) ? RECORD_SEP : (char) 200;
+    fprintf(pFile, ">%s%d_c%d_%d_%c_%d\n%.*s\n", bad ? "bad" : "r", k, rec, off, strand, edits, m, read);
+  }
+  fclose(pFile);
+}
+
+// scores a mapped read from its CIGAR against the record, and checks that
+// the CIGAR covers the read and stays inside the record. returns false if
+// it doesn't.
+static bool cigarScore(char * cigar, char * read, int m, char * ref, int refLen, int * pScore) {
+  int i = 0;
+  int j = 0;
+  int score = 0;
+  char * p = cigar;
+  while (*p) {
+    int run = strtol(p, &p, 10);
+    char op = *p++;
+    for (int k = 0; k < run; k++) {
+      if (op == 'M') {
+        if (i >= m || j >= refLen) return false;
+        score -= read[i++] != ref[j++];
+      } else if (op == 'I') {
+        if (i >= m) return false;
+        i++;
+        score--;
+      } else if (op == 'D') {
+        if (j >= refLen) return false;
+        j++;
+        score--;
+      } else {
+        return false;
+      }
+    }
+  }
+  *pScore = score;
+  return i == m;
+}
+
+// checks one line of mapping output against where its read came from
+static bool checkLine(char * line, char * readsText, char ** seqs, int * lens) {
+  char name [64];
+  char recName [64];
+  int offset;
+  char strand;
+  int score;
+  char cigar [4 * MAX_READ];
+  if (sscanf(line, "%63s\t%63s\t%d\t%c\t%d\t%599s", name, recName, &offset, &strand, &score, cigar) != 6) {
+    fprintf(stderr, "unreadable mapping %s", line);
+    return false;
+  }
+
+  int k, rec, off, edits;
+  char from;
+  bool bad = strncmp(name, "bad", 3) == 0;
+  sscanf(name + (bad ? 3 : 1), "%d_c%d_%d_%c_%d", &k, &rec, &off, &from, &edits);
+  if (bad) {
+    if (strcmp(recName, "*") == 0) return true;
+    fprintf(stderr, "%s holds a separator or a high byte but mapped to %s\n", name, recName);
+    return false;
+  }
+  if (strcmp(recName, "*") == 0) {
+    fprintf(stderr, "%s came out unmapped\n", name);
+    return false;
+  }
+
+  // the read as it was written, on the strand it mapped to
+  char key [80];
+  snprintf(key, sizeof(key), ">%s\n", name);
+  char * seq = strstr(readsText, key) + strlen(key);
+  int m = strchr(seq, '\n') - seq;
+  char read [2 * MAX_READ + 1];
+  if (strand == '-') {
+    reverseComplement(read, seq, m);
+  } else {
+    memcpy(read, seq, m);
+  }
+
+  char expected [16];
+  snprintf(expected, sizeof(expected), "c%d", rec);
+  int got;
+  if (strcmp(recName, expected) != 0 || strand != from || abs(offset - off) > edits) {
+    fprintf(stderr, "%s mapped to %s at %d on %c\n", name, recName, offset, strand);
+    return false;
+  }
+  if (!cigarScore(cigar, read, m, seqs[rec] + offset, lens[rec] - offset, &got) || got != score) {
+    fprintf(stderr, "%s has CIGAR %s with score %d, which scores %d against the record\n",
+      name, cigar, score, got);
+    return false;
+  }
+  if (score < -edits) {
+    fprintf(stderr, "%s scored %d with only %d edits made to it\n", name, score, edits);
+    return false;
+  }
+  return true;
+}
+
+static char * readFile(FILE * pFile) {
+  fseek(pFile, 0, SEEK_END);
+  long len = ftell(pFile);
+  char * out = malloc(len + 1);
+  rewind(pFile);
+  out[fread(out, 1, len, pFile)] = 0;
+  return out;
+}
+
+// maps the reads in readsPath against col, with stdout going to outFile and
+// the mapper's complaints about bad reads dropped, and checks every line
+static bool checkMapping(fmCollection * col, char * readsPath, FILE * outFile, char ** seqs, int * lens) {
+  mapParams params = { MAP_MIN_SEED, MAP_MAX_OCC, MAP_BAND, MAP_LOOKBACK, 0, -1, -1 };
+  fflush(stdout);
+  rewind(stdout);
+  ftruncate(fileno(stdout), 0);
+  int err = dup(2);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, 2);
+  close(null);
+  seqReader * reads = openSeqReader(readsPath);
+  bool ok = reads && mapReads(col, reads, &params);
+  if (reads) closeSeqReader(reads);
+  dup2(err, 2);
+  close(err);
+  fflush(stdout);
+  if (!ok) {
+    fprintf(stderr, "mapReads failed on %s\n", readsPath);
+    return false;
+  }
+
+  FILE * readsFile = fopen(readsPath, "r");
+  char * readsText = readFile(readsFile);
+  fclose(readsFile);
+  char * out = readFile(outFile);
+  int nLines = 0;
+  for (char * line = out; ok && *line; line = strchr(line, '\n') + 1) {
+    ok = checkLine(line, readsText, seqs, lens);
+    nLines++;
+  }
+  if (ok && nLines != READS) {
+    fprintf(stderr, "%d reads went in and %d mappings came out\n", READS, nLines);
+    ok = false;
+  }
+  free(out);
+  free(readsText);
+  return ok;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  state = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+
+  char readsPath [] = "/tmp/mapcheckXXXXXX";
+  char indexPath [] = "/tmp/mapcheckXXXXXX";
+  char outPath [] = "/tmp/mapcheckXXXXXX";
+  int fds [3] = { mkstemp(readsPath), mkstemp(indexPath), mkstemp(outPath) };
+  if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0 || !freopen(outPath, "w+", stdout)) {
+    fprintf(stderr, "mapping: can't make a file in /tmp\n");
+    return 1;
+  }
+  for (int k = 0; k < 3; k++) {
+    close(fds[k]);
+  }
+
+  size_t nSegments = 0;
+  bool ok = true;
+  int round;
+  for (round = 0; round < ROUNDS && ok; round++) {
+    int nRec = 1 + below(MAX_RECORDS);
+    char * seqs [MAX_RECORDS];
+    int lens [MAX_RECORDS];
+    size_t n;
+    recordTable * records;
+    char * s = randomGenome(nRec, seqs, &n, &records);
+    for (int i = 0; i < nRec; i++) {
+      lens[i] = (i + 1 < nRec ? records->start[i + 1] - 1 : (int) n - 1) - records->start[i];
+    }
+    writeReads(readsPath, nRec, seqs, lens);
+
+    // every other genome is saved one record per segment, so seeds and
+    // chains come from several segments
+    fmCollection * col;
+    if (round % 2 == 0) {
+      col = singleCollection(makeFmIndex(strdup(s), n, NULL, NULL, records));
+    } else {
+      for (int i = 0; i < nRec && ok; i++) {
+        recordTable * one = makeRecordTable();
+        char name [16];
+        snprintf(name, sizeof(name), "c%d", i);
+        addRecord(one, name, strlen(name), 0);
+        char * t = malloc(lens[i] + 2);
+        memcpy(t, seqs[i], lens[i]);
+        t[lens[i]] = TEXT_END;
+        t[lens[i] + 1] = 0;
+        ok = i == 0 ? writeIndexFile(indexPath, t, lens[i] + 1, one) :
+          appendIndexFile(indexPath, t, lens[i] + 1, one);
+      }
+      freeRecordTable(records);
+      col = ok ? readIndexFile(indexPath) : NULL;
+      ok = col != NULL;
+    }
+
+    if (ok) {
+      nSegments += col->nSeg;
+      ok = checkMapping(col, readsPath, stdout, seqs, lens);
+    }
+    freeCollection(col);
+    free(s);
+  }
+  unlink(readsPath);
+  unlink(indexPath);
+  unlink(outPath);
+
+  if (!ok) {
+    fprintf(stderr, "mapping: FAILED\n");
+    return 1;
+  }
+  fprintf(stderr, "mapping: %d genomes over %zu segments, %d reads each on both strands: "
+    "every read maps where it came from\n", round, nSegments, READS);
+  return 0;
+}
@@ -0,0 +1,342 @@
+/**********************************************************************
+ * checks the sequence reader against a plain reference parser        *
+ * seqcheck.c                                                         *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "seqio.h"
+
+#define ROUNDS    400   // files generated and read
+#define MAX_RECS  30    // records in a file
+#define MAX_LEN   300   // length of a record's sequence
+#define LONG_LINE 70000 // a line longer than one gzip block
+
+// a growing block of text
+typedef struct text_S {
+  char * s;
+  size_t n;
+  size_t cap;
+} text;
+
+// the records the reference parser finds, and whether it found the file
+// malformed after them
+typedef struct refSet_S {
+  seqRecord * rec;
+  size_t n;
+  bool failed;
+} refSet;
+
+// one line of a file, without its line ending
+typedef struct line_S {
+  char * s;
+  size_t len;
+} line;
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same files
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+static void put(text * t, const char * s, size_t n) {
+  if (t->n + n + 1 > t->cap) {
+    t->cap = 2 * (t->n + n + 1);
+    t->s = realloc(t->s, t->cap);
+  }
+  memcpy(t->s + t->n, s, n);
+  t->n += n;
+  t->s[t->n] = 0;
+}
+
+static void putLine(text * t, const char * s, size_t n, bool crlf) {
+  put(t, s, n);
+  put(t, crlf ? "\r\n" : "\n", crlf ? 2 : 1);
+}
+
+// s wrapped at width, with blank lines now and then when blanks is set
+static void putWrapped(text * t, char * s, size_t n, size_t width, bool crlf, bool blanks) {
+  for (size_t i = 0; i < n; i += width) {
+    putLine(t, s + i, n - i < width ? n - i : width, crlf);
+    if (blanks && below(8) == 0) putLine(t, "", 0, crlf);
+  }
+}
+
+// a random FASTA or FASTQ file, with the layouts the reader has to cope
+// with: wrapped lines, CRLF endings, blank lines, comments, headers with
+// descriptions, empty records, data before the first header, qualities
+// that start with '@' or '+', lines longer than a gzip block, and no
+// newline at the end. Now and then a FASTQ file is broken on purpose.
+static void randomFile(text * t) {
+  bool fastq = below(2);
+  bool crlf = below(4) == 0;
+  bool blanks = below(3) == 0;
+  size_t width = below(4) == 0 ? LONG_LINE : 1 + below(80);
+  size_t nRec = below(MAX_RECS + 1);
+  size_t broken = fastq && below(12) == 0 ? below(nRec + 1) : nRec;
+  const char * alph = fastq ? "ACGTNacgtn" : "ACGTNacgtn;@+";
+  size_t k = strlen(alph);
+  char * seq = malloc(LONG_LINE + MAX_LEN + 1);
+  char * qual = malloc(LONG_LINE + MAX_LEN + 1);
+  char header [64];
+
+  t->n = 0;
+  if (!fastq && below(10) == 0) putLine(t, "; a comment before anything", 27, crlf);
+  if (!fastq && below(10) == 0) putWrapped(t, "ACGTACGT", 8, width, crlf, false);
+  for (size_t r = 0; r < nRec; r++) {
+    size_t n = below(10) == 0 ? 0 : 1 + below(MAX_LEN);
+    if (below(40) == 0) n += LONG_LINE;
+    for (size_t i = 0; i < n; i++) {
+      seq[i] = alph[below(k)];
+      qual[i] = '!' + below(42);
+    }
+    // sequence lines may not be read as headers, comments or the '+' line
+    for (size_t i = 0; i < n; i += width) {
+      if (seq[i] == ';' || seq[i] == '@' || seq[i] == '+') seq[i] = 'A';
+    }
+    int h = snprintf(header, sizeof(header), "%cr%zu%s", fastq ? '@' : '>', r,
+      below(3) == 0 ? (below(2) ? " some description" : "\tx=1") : "");
+    putLine(t, header, h, crlf);
+    if (!fastq && below(10) == 0) putLine(t, ";comment", 8, crlf);
+    putWrapped(t, seq, n, width, crlf, blanks);
+    if (!fastq) continue;
+    if (r == broken && below(2)) {
+      // no '+' line, or a quality line short
+      if (below(2)) {
+        putWrapped(t, qual, n, width, crlf, false);
+      } else {
+        putLine(t, "+", 1, crlf);
+        putWrapped(t, qual, n > 0 ? n - 1 : 0, width, crlf, false);
+      }
+      putLine(t, "@after", 6, crlf);
+      break;
+    }
+    putLine(t, "+", 1, crlf);
+    // qualities are never interrupted by blank lines
+    putWrapped(t, qual, n, width, crlf, false);
+    if (r == broken) {
+      putLine(t, "not a header", 12, crlf);
+      break;
+    }
+    if (blanks && below(4) == 0) putLine(t, "", 0, crlf);
+  }
+  // drop the last line ending
+  if (below(4) == 0) {
+    while (t->n > 0 && (t->s[t->n - 1] == '\n' || t->s[t->n - 1] == '\r')) t->n--;
+  }
+  free(seq);
+  free(qual);
+}
+
+// the name of a header line: its first word after the marker
+static char * headerName(line l) {
+  size_t m = 1;
+  while (m < l.len && l.s[m] != ' ' && l.s[m] != '\t') m++;
+  return strndup(l.s + 1, m - 1);
+}
+
+static void addRef(refSet * set, char * name, text * seq, text * qual) {
+  set->rec = realloc(set->rec, sizeof(seqRecord) * (set->n + 1));
+  set->rec[set->n++] = (seqRecord) {
+    name,
+    strndup(seq->s ? seq->s : "", seq->n),
+    seq->n,
+    qual ? strndup(qual->s ? qual->s : "", qual->n) : NULL
+  };
+}
+
+// parses the whole text line by line, the slow and obvious way
+static refSet parseReference(char * s, size_t size) {
+  refSet set = { NULL, 0, false };
+  line * L = malloc(sizeof(line) * (size + 1));
+  size_t nLines = 0;
+  for (size_t pos = 0; pos < size;) {
+    char * end = memchr(s + pos, '\n', size - pos);
+    size_t len = end ? (size_t) (end - (s + pos)) : size - pos;
+    L[nLines] = (line) { s + pos, len };
+    while (L[nLines].len > 0 && L[nLines].s[L[nLines].len - 1] == '\r') L[nLines].len--;
+    nLines++;
+    pos += len + 1;
+  }
+
+  size_t i = 0;
+  while (i < nLines && (L[i].len == 0 || L[i].s[0] == ';')) i++;
+  if (i == nLines) {
+    free(L);
+    return set;
+  }
+  bool fastq = L[i].s[0] == '@';
+  char * name;
+  if (fastq || L[i].s[0] == '>') {
+    name = headerName(L[i++]);
+  } else {
+    name = strdup("*");
+  }
+
+  text seq = { NULL, 0, 0 };
+  text qual = { NULL, 0, 0 };
+  for (;;) {
+    seq.n = 0;
+    qual.n = 0;
+    bool plus = false;
+    for (; i < nLines; i++) {
+      if (L[i].len == 0 || (!fastq && L[i].s[0] == ';')) continue;
+      if (!fastq && L[i].s[0] == '>') break;
+      if (fastq && L[i].s[0] == '+') {
+        plus = true;
+        i++;
+        break;
+      }
+      put(&seq, L[i].s, L[i].len);
+    }
+    if (fastq) {
+      for (; plus && qual.n < seq.n && i < nLines; i++) {
+        put(&qual, L[i].s, L[i].len);
+      }
+      while (i < nLines && L[i].len == 0) i++;
+      if (!plus || qual.n != seq.n || (i < nLines && L[i].s[0] != '@')) {
+        set.failed = true;
+        free(name);
+        break;
+      }
+    }
+    addRef(&set, name, &seq, fastq ? &qual : NULL);
+    if (i == nLines) break;
+    name = headerName(L[i++]);
+  }
+  free(seq.s);
+  free(qual.s);
+  free(L);
+  return set;
+}
+
+static void freeRef(refSet * set) {
+  for (size_t i = 0; i < set->n; i++) {
+    free(set->rec[i].name);
+    free(set->rec[i].seq);
+    free(set->rec[i].qual);
+  }
+  free(set->rec);
+}
+
+static bool sameRecord(seqRecord * a, seqRecord * b) {
+  if (strcmp(a->name, b->name) != 0 || a->len != b->len) return false;
+  if (memcmp(a->seq, b->seq, a->len) != 0 || b->seq[b->len] != 0) return false;
+  if ((a->qual == NULL) != (b->qual == NULL)) return false;
+  return a->qual == NULL || (memcmp(a->qual, b->qual, a->len) == 0 && b->qual[b->len] == 0);
+}
+
+// reads path one record at a time and compares with the reference
+static bool checkStream(char * path, refSet * ref) {
+  seqReader * r = openSeqReader(path);
+  if (r == NULL) return false;
+  seqRecord rec;
+  size_t k = 0;
+  bool ok = true;
+  while (ok && nextSeq(r, &rec)) {
+    ok = k < ref->n && sameRecord(&ref->rec[k], &rec);
+    if (!ok) fprintf(stderr, "%s: record %zu differs when streamed\n", path, k);
+    k++;
+  }
+  if (ok && (k != ref->n || r->failed != ref->failed)) {
+    fprintf(stderr, "%s: streamed %zu records%s, expected %zu%s\n", path, k,
+      r->failed ? " then failed" : "", ref->n, ref->failed ? " then failed" : "");
+    ok = false;
+  }
+  closeSeqReader(r);
+  return ok;
+}
+
+// reads path as a whole set and compares with the reference
+static bool checkSet(char * path, refSet * ref) {
+  seqSet * set = readSeqSet(path);
+  if (ref->failed || set == NULL) {
+    if ((set == NULL) != ref->failed) fprintf(stderr, "%s: set read %s\n", path, set ? "should have failed" : "failed");
+    freeSeqSet(set);
+    return (set == NULL) == ref->failed;
+  }
+  bool ok = set->n == ref->n;
+  for (size_t k = 0; ok && k < set->n; k++) {
+    ok = sameRecord(&ref->rec[k], &set->rec[k]);
+    if (!ok) fprintf(stderr, "%s: record %zu differs in the set\n", path, k);
+  }
+  if (set->n != ref->n) fprintf(stderr, "%s: set has %zu records, expected %zu\n", path, set->n, ref->n);
+  freeSeqSet(set);
+  return ok;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  state = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+  // the reader reports malformed files on stdout
+  freopen("/dev/null", "w", stdout);
+
+  char dir [] = "/tmp/seqcheck.XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "error making a directory in /tmp\n");
+    return 1;
+  }
+  char plain [64];
+  char gz [64];
+  snprintf(plain, sizeof(plain), "%s/in.fa", dir);
+  snprintf(gz, sizeof(gz), "%s/in.fa.gz", dir);
+
+  text t = { NULL, 0, 0 };
+  size_t nRecords = 0;
+  size_t nFailed = 0;
+  bool ok = true;
+  for (int round = 0; round < ROUNDS && ok; round++) {
+    randomFile(&t);
+    FILE * pFile = fopen(plain, "wb");
+    gzFile gFile = gzopen(gz, "wb");
+    if (pFile == NULL || gFile == NULL) {
+      fprintf(stderr, "error writing file in %s\n", dir);
+      return 1;
+    }
+    fwrite(t.s, sizeof(char), t.n, pFile);
+    fclose(pFile);
+    gzwrite(gFile, t.s, t.n);
+    gzclose(gFile);
+
+    refSet ref = parseReference(t.s, t.n);
+    ok = checkStream(plain, &ref) && checkStream(gz, &ref) && checkSet(plain, &ref) && checkSet(gz, &ref);
+    nRecords += ref.n;
+    nFailed += ref.failed;
+    freeRef(&ref);
+  }
+  free(t.s);
+
+  // a failing file is left behind to look at
+  if (!ok) {
+    fprintf(stderr, "seqio: FAILED, input kept in %s\n", dir);
+    return 1;
+  }
+  unlink(plain);
+  unlink(gz);
+  rmdir(dir);
+  fprintf(stderr, "seqio: %d files, %zu records, %zu malformed: reader matches the reference\n",
+    ROUNDS, nRecords, nFailed);
+  return 0;
+}
@@ -0,0 +1,378 @@
+/**********************************************************************
+ * checks the fmsearch query server against searches made in process *
+ * servercheck.c                                                      *
+ * Aleksandr Means                                                    *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "fmindex.h"
+#include "fmstore.h"
+#include "server.h"
+
+#define ROUNDS      6    // random genomes, each served in turn
+#define MAX_RECORDS 5    // records in a genome
+#define MIN_RECORD  200  // length of a record
+#define MAX_RECORD  3000
+#define MAX_PATTERN 12   // length of a pattern
+#define REQUESTS    300  // requests each client sends
+#define CLIENTS     4    // clients connected at once
+#define SLICE       300  // bytes a client sends before the next one does
+#define THREADS     3    // server worker threads
+
+/**
+ * Helper functions
+ */
+
+static uint64_t state;
+
+// splitmix64, so a seed always gives the same genomes and requests
+static uint64_t nextRandom(void) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) {
+  return nextRandom() % n;
+}
+
+// a genome of random records named c0, c1, ..., saved to path a few records
+// per segment, the way -w and -a save them, and read back
+static fmCollection * randomCollection(char * path) {
+  int nRec = 1 + below(MAX_RECORDS);
+  bool ok = true;
+  for (int first = 0; first < nRec && ok;) {
+    int last = first + below(nRec - first);
+    char * s = malloc((last - first + 1) * (MAX_RECORD + 1) + 2);
+    size_t n = 0;
+    recordTable * records = makeRecordTable();
+    for (int i = first; i <= last; i++) {
+      char name [16];
+      snprintf(name, sizeof(name), "c%d", i);
+      if (i > first) s[n++] = RECORD_SEP;
+      addRecord(records, name, strlen(name), n);
+      size_t len = MIN_RECORD + below(MAX_RECORD - MIN_RECORD + 1);
+      for (size_t j = 0; j < len; j++) {
+        s[n++] = "ACGT"[below(4)];
+      }
+    }
+    s[n++] = TEXT_END;
+    s[n] = 0;
+    ok = first == 0 ? writeIndexFile(path, s, n, records) : appendIndexFile(path, s, n, records);
+    first = last + 1;
+  }
+  return ok ? readIndexFile(path) : NULL;
+}
+
+// a request line: mostly an operation on a piece of some segment's text,
+// which may hold a record separator, or on a random pattern, and now and
+// then one the server must refuse
+static void randomRequest(fmCollection * col, char * out) {
+  static const char * OPS [] = { "count", "range", "locate" };
+  size_t kind = below(40);
+  if (kind == 0) {
+    strcpy(out, below(2) ? "count" : "range ");
+    return;
+  }
+  int k = sprintf(out, "%s ", kind == 1 ? "find" : OPS[below(3)]);
+  size_t m = 1 + below(MAX_PATTERN);
+  if (below(3)) {
+    fmIndex * index = col->seg[below(col->nSeg)];
+    size_t at = below(index->n - 1);
+    if (m > index->n - 1 - at) m = index->n - 1 - at;
+    memcpy(out + k, index->s + at, m);
+  } else {
+    for (size_t i = 0; i < m; i++) {
+      out[k + i] = "ACGT"[below(4)];
+    }
+  }
+  out[k + m] = 0;
+}
+
+// the reply the server owes a request, made the way the one-shot search
+// makes it: fmRange over each segment for the ranges, and a plain scan of
+// each record for the count and the places
+static void expectedReply(fmCollection * col, char * line, FILE * out) {
+  char op [16];
+  char * q = strchr(line, ' ');
+  if (q == NULL || q[1] == 0) {
+    fprintf(out, "error expected an operation and a pattern\n");
+    return;
+  }
+  snprintf(op, sizeof(op), "%.*s", (int) (q - line), line);
+  q++;
+  size_t m = strlen(q);
+  if (strcmp(op, "count") != 0 && strcmp(op, "range") != 0 && strcmp(op, "locate") != 0) {
+    fprintf(out, "error unknown operation %s\n", op);
+    return;
+  }
+
+  long long total = 0;
+  char * sep = "";
+  for (int k = 0; k < col->nSeg; k++) {
+    fmIndex * index = col->seg[k];
+    recordTable * records = index->records;
+    int st, ed;
+    if (strcmp(op, "range") == 0 && fmRange(index, q, m, &st, &ed)) {
+      fprintf(out, "%s%d:%d-%d", sep, k, st, ed);
+      sep = " ";
+    }
+    for (int r = 0; r < records->n; r++) {
+      size_t start = records->start[r];
+      size_t end = r + 1 < records->n ? (size_t) records->start[r + 1] - 1 : index->n - 1;
+      for (size_t i = start; i + m <= end; i++) {
+        if (memcmp(index->s + i, q, m) != 0) continue;
+        total++;
+        if (strcmp(op, "locate") == 0) {
+          fprintf(out, "%s%s:%zu", sep, recordName(records, r), i - start);
+          sep = " ";
+        }
+      }
+    }
+  }
+  if (strcmp(op, "count") == 0) fprintf(out, "%lld", total);
+  fprintf(out, "\n");
+}
+
+static char * readFile(FILE * pFile) {
+  fflush(pFile);
+  fseek(pFile, 0, SEEK_END);
+  long len = ftell(pFile);
+  char * out = malloc(len + 1);
+  rewind(pFile);
+  out[fread(out, 1, len, pFile)] = 0;
+  return out;
+}
+
+// reports the first reply where got and expected differ, and returns true
+// if they don't
+static bool sameReplies(char * who, char * got, char * expected, char * requests) {
+  if (strcmp(got, expected) == 0) return true;
+  size_t line = 0;
+  while (*got && *got == *expected) {
+    if (*got == '\n') {
+      line++;
+      requests = strchr(requests, '\n') + 1;
+    }
+    got++;
+    expected++;
+  }
+  fprintf(stderr, "%s got a wrong reply %zu to %.*s\n", who, line + 1,
+    (int) strcspn(requests, "\r\n"), requests);
+  return false;
+}
+
+// starts a server on col at path in a child, and waits until it is
+// listening
+static pid_t startServer(fmCollection * col, char * path) {
+  int fds [2];
+  if (pipe(fds) < 0) return -1;
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    dup2(fds[1], fileno(stdout));
+    close(fds[1]);
+    _exit(serveIndex(col, path, THREADS) ? 0 : 1);
+  }
+  close(fds[1]);
+  // the server says so once it is listening
+  char c = 0;
+  while (pid > 0 && c != '\n' && read(fds[0], &c, 1) == 1);
+  close(fds[0]);
+  return c == '\n' ? pid : -1;
+}
+
+static int connectTo(char * path) {
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// CLIENTS clients connect at once and send all their requests, some ending
+// in CR LF, a few hundred bytes from each in turn so lines are split and
+// batches mix clients. Only then is a reply read, and each client must get
+// its own replies back in order.
+static bool checkClients(fmCollection * col, char * path) {
+  int fds [CLIENTS];
+  char * sent [CLIENTS];
+  size_t sentLen [CLIENTS];
+  char * expected [CLIENTS];
+  bool ok = true;
+  for (int c = 0; c < CLIENTS; c++) {
+    size_t expLen;
+    FILE * requests = open_memstream(&sent[c], &sentLen[c]);
+    FILE * replies = open_memstream(&expected[c], &expLen);
+    char line [64];
+    for (int k = 0; k < REQUESTS; k++) {
+      randomRequest(col, line);
+      fprintf(requests, "%s%s\n", line, below(10) == 0 ? "\r" : "");
+      expectedReply(col, line, replies);
+    }
+    fclose(requests);
+    fclose(replies);
+    fds[c] = connectTo(path);
+    ok &= fds[c] >= 0;
+  }
+  for (size_t pos = 0; ok; pos += SLICE) {
+    bool more = false;
+    for (int c = 0; c < CLIENTS && ok; c++) {
+      if (pos >= sentLen[c]) continue;
+      size_t k = sentLen[c] - pos < SLICE ? sentLen[c] - pos : SLICE;
+      ok = write(fds[c], sent[c] + pos, k) == (ssize_t) k;
+      more = true;
+    }
+    if (!more) break;
+  }
+  for (int c = 0; c < CLIENTS; c++) {
+    char * got = NULL;
+    size_t len;
+    FILE * replies = open_memstream(&got, &len);
+    char buf [4096];
+    ssize_t k;
+    if (fds[c] >= 0) {
+      shutdown(fds[c], SHUT_WR);
+      while ((k = read(fds[c], buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, k, replies);
+      }
+      close(fds[c]);
+    }
+    fclose(replies);
+    if (ok) {
+      char who [16];
+      snprintf(who, sizeof(who), "client %d", c + 1);
+      ok = sameReplies(who, got, expected[c], sent[c]);
+    }
+    free(got);
+    free(sent[c]);
+    free(expected[c]);
+  }
+  return ok;
+}
+
+// fmsearch -q sends one request from its arguments, or every line of stdin
+// CLIENT_WINDOW at a time, and prints the replies on stdout, which is outFile
+// here
+static bool checkQueries(fmCollection * col, char * path, char * requestsPath, FILE * outFile) {
+  char * expected;
+  size_t len;
+  FILE * replies = open_memstream(&expected, &len);
+  FILE * requests = fopen(requestsPath, "w");
+  char line [64];
+  for (int k = 0; k < REQUESTS; k++) {
+    randomRequest(col, line);
+    fprintf(requests, "%s\n", line);
+    expectedReply(col, line, replies);
+  }
+  fclose(requests);
+  fclose(replies);
+
+  // one request as arguments
+  char * last = strrchr(expected, '\n');
+  while (last > expected && last[-1] != '\n') last--;
+  char * op = strtok(line, " ");
+  char * q = strtok(NULL, "");
+  char * args [2] = { op, q };
+  rewind(outFile);
+  ftruncate(fileno(outFile), 0);
+  bool ok = queryServer(path, q ? 2 : 1, args);
+  char * got = readFile(outFile);
+  ok = ok && sameReplies("fmsearch -q with arguments", got, last, last);
+  free(got);
+
+  // every request on stdin
+  rewind(outFile);
+  ftruncate(fileno(outFile), 0);
+  ok = ok && freopen(requestsPath, "r", stdin) && queryServer(path, 0, NULL);
+  got = ok ? readFile(outFile) : NULL;
+  FILE * sent = fopen(requestsPath, "r");
+  char * sentText = readFile(sent);
+  fclose(sent);
+  ok = ok && sameReplies("fmsearch -q on stdin", got, expected, sentText);
+  free(sentText);
+  free(got);
+  free(expected);
+  return ok;
+}
+
+
+/**
+ * primary calls
+ */
+
+int main(int argc, char ** argv) {
+  state = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+
+  char dir [] = "/tmp/servercheckXXXXXX";
+  char outPath [] = "/tmp/servercheckXXXXXX";
+  int fd = mkstemp(outPath);
+  if (mkdtemp(dir) == NULL || fd < 0 || !freopen(outPath, "w+", stdout)) {
+    fprintf(stderr, "server: can't make a file in /tmp\n");
+    return 1;
+  }
+  close(fd);
+  char sockPath [64];
+  char indexPath [64];
+  char requestsPath [64];
+  snprintf(sockPath, sizeof(sockPath), "%s/socket", dir);
+  snprintf(indexPath, sizeof(indexPath), "%s/index", dir);
+  snprintf(requestsPath, sizeof(requestsPath), "%s/requests", dir);
+
+  size_t nSegments = 0;
+  bool ok = true;
+  int round;
+  for (round = 0; round < ROUNDS && ok; round++) {
+    fmCollection * col = randomCollection(indexPath);
+    ok = col != NULL;
+    pid_t pid = ok ? startServer(col, sockPath) : -1;
+    if (ok && pid < 0) {
+      fprintf(stderr, "the server never started listening\n");
+      ok = false;
+    }
+    if (ok) {
+      nSegments += col->nSeg;
+      ok = checkClients(col, sockPath) && checkQueries(col, sockPath, requestsPath, stdout);
+    }
+
+    // SIGTERM stops the server cleanly, and it takes its socket with it
+    int status = 0;
+    if (pid > 0) {
+      kill(pid, SIGTERM);
+      waitpid(pid, &status, 0);
+    }
+    if (ok && (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || access(sockPath, F_OK) == 0)) {
+      fprintf(stderr, "the server did not shut down cleanly on SIGTERM\n");
+      ok = false;
+    }
+    if (col) freeCollection(col);
+  }
+  unlink(sockPath);
+  unlink(indexPath);
+  unlink(requestsPath);
+  unlink(outPath);
+  rmdir(dir);
+
+  if (!ok) {
+    fprintf(stderr, "server: FAILED\n");
+    return 1;
+  }
+  fprintf(stderr, "server: %d indexes over %zu segments, %d clients of %d requests and fmsearch -q: "
+    "replies match in-process searches\n", round, nSegments, CLIENTS, REQUESTS);
+  return 0;
+}